@@ -2,91 +2,3137 @@
 #define BM_BENCHMARK_HPP_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <cctype>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <fstream>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <ostream>
+#include <random>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifdef BM_MPI_SUPPORT
 #include <mpi.h>
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define BM_TSC_SUPPORT
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#define BM_TSC_SUPPORT
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#if defined(_WIN32)
+#define BM_MMAP_SUPPORT
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define BM_MMAP_SUPPORT
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace bm
 {
+// Forces the value to be computed and kept, as if it was read and written by an opaque observer.
+#if defined(__GNUC__) || defined(__clang__)
+// Scalars which fit a register are passed in one, others (e.g. aggregates of odd sizes, which no register constraint accepts) through memory. Constraints with several alternatives are avoided as
+// compilers are known to lose the written value when choosing between them (e.g. GCC 12 with -fsanitize=undefined).
+template <typename type>
+inline void do_not_optimize(const type& value)
+{
+  if constexpr (std::is_scalar_v<type> && sizeof(type) <= sizeof(void*))
+    asm volatile("" : : "r"(value) : "memory");
+  else
+    asm volatile("" : : "m"(value) : "memory");
+}
+template <typename type>
+inline void do_not_optimize(type&       value)
+{
+  if constexpr (std::is_scalar_v<type> && sizeof(type) <= sizeof(void*))
+    asm volatile("" : "+r"(value) : : "memory");
+  else
+    asm volatile("" : "+m"(value) : : "memory");
+}
+// Forces all pending writes to memory to be performed, and all subsequent reads to be performed from memory.
+inline void clobber_memory()
+{
+  asm volatile("" : : : "memory");
+}
+#else
+template <typename type>
+inline void do_not_optimize(const type& value)
+{
+  static const volatile void* volatile sink;
+  sink = &value;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+inline void clobber_memory()
+{
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+#endif
+
+// Calls the function and keeps its result, if any, from being optimized away.
+template <typename function_type>
+inline void invoke_and_sink(function_type& function)
+{
+  if constexpr (std::is_void_v<std::invoke_result_t<function_type&>>)
+    function();
+  else
+    do_not_optimize(function());
+}
+
+// Time stamp counter clock, calibrated against std::chrono::steady_clock on first use.
+// Falls back to std::chrono::steady_clock if the processor lacks an invariant time stamp counter or rdtscp.
+// Counts fractional nanoseconds, hence keeps the resolution of a tick.
+class  tsc_clock
+{
+public:
+  using rep        = double;
+  using period     = std::nano;
+  using duration   = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<tsc_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now      () noexcept
+  {
+    const auto& state = calibration();
+    if (!state.invariant)
+      return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+    // Signed, since a core whose counter is slightly behind the one of the calibration reads less than the base.
+    const auto elapsed = static_cast<std::int64_t>(ticks() - state.base);
+    return time_point(duration(static_cast<rep>(elapsed) * state.nanoseconds_per_tick));
+  }
+  static bool       invariant() noexcept
+  {
+    return calibration().invariant;
+  }
+  static double     frequency() noexcept
+  {
+    return calibration().invariant ? 1e9 / calibration().nanoseconds_per_tick : 0.0;
+  }
+
+protected:
+  struct state
+  {
+    bool          invariant            = false;
+    std::uint64_t base                 = 0;
+    double        nanoseconds_per_tick = 1.0;
+  };
+
+  static bool          detect     () noexcept
+  {
+#if defined(BM_TSC_SUPPORT) && defined(_MSC_VER)
+    std::int32_t registers[4];
+    __cpuid(registers, 0x80000000);
+    if (static_cast<std::uint32_t>(registers[0]) < 0x80000007)
+      return false;
+    __cpuid(registers, 0x80000001);
+    const bool rdtscp    = (registers[3] & (1 << 27)) != 0;
+    __cpuid(registers, 0x80000007);
+    const bool invariant = (registers[3] & (1 << 8 )) != 0;
+    return rdtscp && invariant;
+#elif defined(BM_TSC_SUPPORT)
+    std::uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+      return false;
+    __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    const bool rdtscp    = (edx & (1u << 27)) != 0;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    const bool invariant = (edx & (1u << 8 )) != 0;
+    return rdtscp && invariant;
+#else
+    return false;
+#endif
+  }
+  static std::uint64_t ticks      () noexcept
+  {
+#ifdef BM_TSC_SUPPORT
+    // rdtscp waits for the preceding instructions to complete, the fence keeps the subsequent ones from starting early.
+    std::uint32_t auxiliary;
+    const std::uint64_t value = __rdtscp(&auxiliary);
+    _mm_lfence();
+    return value;
+#else
+    return 0;
+#endif
+  }
+  static const state&  calibration() noexcept
+  {
+    static const state instance = []
+    {
+      state result;
+      if (!detect())
+        return result;
+
+      const auto start_time  = std::chrono::steady_clock::now();
+      const auto start_ticks = ticks();
+      while (std::chrono::steady_clock::now() - start_time < std::chrono::milliseconds(20));
+      const auto end_time    = std::chrono::steady_clock::now();
+      const auto end_ticks   = ticks();
+
+      result.invariant            = end_ticks > start_ticks;
+      result.base                 = start_ticks;
+      result.nanoseconds_per_tick = std::chrono::duration<double, std::nano>(end_time - start_time).count() / static_cast<double>(end_ticks - start_ticks);
+      return result;
+    }();
+    return instance;
+  }
+};
+
+// Processor time consumed by the calling thread (thread = true) or the whole process (thread = false).
+// Uses clock_gettime where available and falls back to std::clock, which measures process time, elsewhere.
+template <bool thread>
+class  cpu_clock
+{
+public:
+  using rep        = std::int64_t;
+  using period     = std::nano;
+  using duration   = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<cpu_clock>;
+  static constexpr bool is_steady = false;
+
+  static time_point now() noexcept
+  {
+#if defined(CLOCK_THREAD_CPUTIME_ID) && defined(CLOCK_PROCESS_CPUTIME_ID)
+    timespec time {};
+    clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time_point(duration(static_cast<rep>(time.tv_sec) * 1000000000 + static_cast<rep>(time.tv_nsec)));
+#else
+    return time_point(std::chrono::duration_cast<duration>(std::chrono::duration<double>(static_cast<double>(std::clock()) / CLOCKS_PER_SEC)));
+#endif
+  }
+};
+using thread_cpu_clock  = cpu_clock<true >;
+using process_cpu_clock = cpu_clock<false>;
+
+// Symbol of the unit of a period, e.g. "ms" for std::milli.
+template <typename period>
+std::string unit_symbol()
+{
+  if      constexpr (std::is_same_v<typename period::type, std::nano        >) return "ns" ;
+  else if constexpr (std::is_same_v<typename period::type, std::micro       >) return "us" ;
+  else if constexpr (std::is_same_v<typename period::type, std::milli       >) return "ms" ;
+  else if constexpr (std::is_same_v<typename period::type, std::ratio<1>    >) return "s"  ;
+  else if constexpr (std::is_same_v<typename period::type, std::ratio<60>   >) return "min";
+  else if constexpr (std::is_same_v<typename period::type, std::ratio<3600> >) return "h"  ;
+  else return std::to_string(period::num) + "/" + std::to_string(period::den) + " s";
+}
+// Inverse of unit_symbol, in seconds per unit. An empty unit is taken as the default period (milliseconds).
+inline double     seconds_per_unit(const std::string& unit)
+{
+  static const std::unordered_map<std::string, double> units {{"ns", 1e-9}, {"us", 1e-6}, {"ms", 1e-3}, {"", 1e-3}, {"s", 1.0}, {"min", 60.0}, {"h", 3600.0}};
+  const auto iterator  = units.find(unit);
+  if (iterator != units.end())
+    return iterator->second;
+  // A period of the form num/den s.
+  const auto separator = unit.find('/');
+  return separator != std::string::npos ? std::strtod(unit.c_str(), nullptr) / std::strtod(unit.c_str() + separator + 1, nullptr) : 1.0;
+}
+template <typename clock>
+std::string clock_name ()
+{
+  if      constexpr (std::is_same_v<clock, std::chrono::high_resolution_clock>) return "high_resolution_clock";
+  else if constexpr (std::is_same_v<clock, std::chrono::steady_clock         >) return "steady_clock"         ;
+  else if constexpr (std::is_same_v<clock, std::chrono::system_clock         >) return "system_clock"         ;
+  else if constexpr (std::is_same_v<clock, tsc_clock                         >) return "tsc_clock"            ;
+  else if constexpr (std::is_same_v<clock, thread_cpu_clock                  >) return "thread_cpu_clock"     ;
+  else if constexpr (std::is_same_v<clock, process_cpu_clock                 >) return "process_cpu_clock"    ;
+  else return "custom";
+}
+
+enum class estimator
+{
+  mean  ,
+  median
+};
+enum class bootstrap_method
+{
+  percentile, // Percentiles of the bootstrap distribution.
+  bca         // Bias-corrected and accelerated (Efron), with the acceleration estimated by the jackknife.
+};
+enum class outlier_method
+{
+  none ,
+  tukey, // Beyond 1.5 (mild) or 3 (severe) interquartile ranges outside the quartiles.
+  mad    // Beyond 3 (mild) or 5 (severe) scaled median absolute deviations from the median.
+};
+enum class storage
+{
+  values   , // Every sample is kept in record::values.
+  histogram, // Samples are counted in record::histogram, keeping memory fixed regardless of the number of iterations.
+  reservoir  // A uniform random subset of reservoir_size samples is kept in record::values.
+};
+
+struct options
+{
+  // Maximum number of recorded iterations, preceded by warmup iterations which are executed but not recorded.
+  std::size_t              iterations   = 1;
+  std::size_t              warmup       = 0;
+  // Stops recording early once the run lasted time_budget, or once the standard error of the mean of every record relative to
+  // its mean dropped below target_relative_standard_error. Zero disables either criterion.
+  std::chrono::nanoseconds time_budget  = std::chrono::nanoseconds(0);
+  double                   target_relative_standard_error = 0.0;
+  // Stops recording early once the width of the confidence interval of the mean of every record relative to its mean dropped
+  // below target_confidence_interval. The precision criteria are only checked after min_iterations, and then every so often (see
+  // stop_early), on the records with at least two samples.
+  double                   target_confidence_interval     = 0.0;
+  double                   confidence_level               = 0.95;
+  std::size_t              min_iterations                 = 10;
+  // Repeats the function within each sample until the sample lasts at least batch_target, and stores the time per invocation.
+  bool                     batch        = false;
+  std::chrono::nanoseconds batch_target = std::chrono::microseconds(10);
+  std::size_t              batch_limit  = std::size_t(1) << 30;
+  // Subtracts the mean cost of the clock reads bracketing each sample (see clock_overhead).
+  bool                     subtract_overhead = false;
+  // Additionally stores the thread and process processor time of each sample. The clocks are read nested (process, thread, wall, ...,
+  // wall, thread, process), hence the processor times include the reads of the inner clocks, which are subtracted along with their own
+  // (by clock_overhead of each clock) if subtract_overhead is set.
+  bool                     capture_thread_cpu_time  = false;
+  bool                     capture_process_cpu_time = false;
+  // Records created with preallocated values before the first iteration of a session, so that no allocation happens between iterations.
+  // The handle of each section is its index in this vector, provided the names are unique: a repeated name resolves to the record of
+  // its first occurrence, which shifts the indices of the records of the subsequent names.
+  std::vector<std::string> sections;
+  // Storage of the samples. The histogram range is given in units of the period of the run.
+  bm::storage              storage                      = bm::storage::values;
+  double                   histogram_lowest             = 1e-3;
+  double                   histogram_highest            = 1e+6;
+  std::uint32_t            histogram_significant_digits = 3;
+  std::size_t              reservoir_size               = 1024;
+  // Number of resamples of the bootstrap confidence intervals exported to csv. Zero leaves their columns empty, since resampling
+  // dominates the export of large records.
+  std::size_t              bootstrap_resamples          = 0;
+  // Excludes the outliers classified by the given method from the mean, variance, standard deviation, min, max and confidence interval,
+  // as well as from the stopping criteria. Requires the values, hence has no effect when storing a histogram.
+  outlier_method           exclude_outliers             = outlier_method::none;
+  // Additionally stores the start and end of each recorded section occurrence in session::timeline (see session::to_trace).
+  bool                     timeline                     = false;
+};
+
+struct overhead
+{
+  std::chrono::duration<double, std::nano> mean              ;
+  std::chrono::duration<double, std::nano> standard_deviation;
+};
+
+// Estimates the cost of a pair of consecutive clock reads. Measured once per process and clock.
+template <typename clock = std::chrono::high_resolution_clock>
+const overhead& clock_overhead()
+{
+  static const overhead instance = []
+  {
+    constexpr std::size_t warmup  = 100  ;
+    constexpr std::size_t samples = 10000;
+
+    std::vector<double> durations(warmup + samples);
+    for (auto& duration : durations)
+    {
+      const auto start = clock::now();
+      const auto end   = clock::now();
+      duration = std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    durations.erase(durations.begin(), durations.begin() + warmup);
+
+    const auto mean     = std::accumulate(durations.begin(), durations.end(), 0.0) / static_cast<double>(samples);
+    const auto variance = std::accumulate(durations.begin(), durations.end(), 0.0, [mean] (const double sum, const double value)
+    {
+      return sum + (value - mean) * (value - mean);
+    }) / static_cast<double>(samples);
+    return overhead {std::chrono::duration<double, std::nano>(mean), std::chrono::duration<double, std::nano>(std::sqrt(variance))};
+  }();
+  return instance;
+}
+
 template <typename type = double>
-struct record
+struct interval
 {
-  constexpr type        mean              () const
+  constexpr type width() const
+  {
+    return upper - lower;
+  }
+
+  type lower;
+  type upper;
+};
+
+inline double     normal_cdf        (const double x)
+{
+  return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+// Acklam's rational approximation, refined by a Halley step.
+inline double     normal_quantile   (const double p)
+{
+  if (p <= 0.0 || p >= 1.0)
+    return p <= 0.0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+
+  constexpr double a[] = {-3.969683028665376e+01,  2.209460984245205e+02, -2.759285104469687e+02,  1.383577518672690e+02, -3.066479806614716e+01,  2.506628277459239e+00};
+  constexpr double b[] = {-5.447609879822406e+01,  1.615858368580409e+02, -1.556989798598866e+02,  6.680131188771972e+01, -1.328068155288572e+01};
+  constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00,  4.374664141464968e+00,  2.938163982698783e+00};
+  constexpr double d[] = { 7.784695709041462e-03,  3.224671290700398e-01,  2.445134137142996e+00,  3.754408661907416e+00};
+
+  double x;
+  if      (p < 0.02425)
+  {
+    const auto q = std::sqrt(-2.0 * std::log(p));
+    x =  (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+  }
+  else if (p > 1.0 - 0.02425)
+  {
+    const auto q = std::sqrt(-2.0 * std::log(1.0 - p));
+    x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+  }
+  else
+  {
+    const auto q = p - 0.5;
+    const auto r = q * q;
+    x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+  }
+
+  const auto error = normal_cdf(x) - p;
+  const auto u     = error * std::sqrt(2.0 * 3.14159265358979323846) * std::exp(x * x / 2.0);
+  return x - u / (1.0 + x * u / 2.0);
+}
+// Regularized incomplete beta function I_x(a, b), evaluated through its continued fraction (modified Lentz).
+inline double     incomplete_beta   (const double a, const double b, const double x)
+{
+  if (x <= 0.0)
+    return 0.0;
+  if (x >= 1.0)
+    return 1.0;
+
+  const auto continued_fraction = [] (const double a, const double b, const double x)
+  {
+    constexpr double epsilon = 1e-15;
+    constexpr double minimum = 1e-300;
+    const auto clamp = [minimum] (const double value) { return std::abs(value) < minimum ? minimum : value; };
+
+    double c = 1.0;
+    double d = 1.0 / clamp(1.0 - (a + b) * x / (a + 1.0));
+    double h = d;
+    for (auto m = 1; m <= 300; ++m)
+    {
+      const auto m2   = 2.0 * m;
+      auto       term = m * (b - m) * x / ((a - 1.0 + m2) * (a + m2));
+      d  = 1.0 / clamp(1.0 + term * d);
+      c  = clamp(1.0 + term / c);
+      h *= d * c;
+
+      term = -(a + m) * (a + b + m) * x / ((a + m2) * (a + 1.0 + m2));
+      d  = 1.0 / clamp(1.0 + term * d);
+      c  = clamp(1.0 + term / c);
+      h *= d * c;
+      if (std::abs(d * c - 1.0) < epsilon)
+        break;
+    }
+    return h;
+  };
+
+  const auto front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1.0 - x));
+  if (x < (a + 1.0) / (a + b + 2.0))
+    return front * continued_fraction(a, b, x) / a;
+  return 1.0 - front * continued_fraction(b, a, 1.0 - x) / b;
+}
+inline double     student_t_cdf     (const double t, const double degrees_of_freedom)
+{
+  const auto tail = 0.5 * incomplete_beta(degrees_of_freedom / 2.0, 0.5, degrees_of_freedom / (degrees_of_freedom + t * t));
+  return t > 0.0 ? 1.0 - tail : tail;
+}
+// Cornish-Fisher expansion around the normal quantile, refined by Newton steps on the cumulative distribution function.
+inline double     student_t_quantile(const double p, const double degrees_of_freedom)
+{
+  if (p <= 0.0 || p >= 1.0)
+    return p <= 0.0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+
+  const auto v  = degrees_of_freedom;
+  const auto z  = normal_quantile(p);
+  const auto z3 = z * z * z, z5 = z3 * z * z, z7 = z5 * z * z;
+  auto t = z + (z3 + z) / (4.0 * v) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * v * v) + (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * v * v * v);
+  // The expansion is exact to within its next term, of order 1 / v^4, hence refining it is only worth its cost for few degrees of freedom.
+  if (v >= 1000.0)
+    return t;
+
+  const auto normalization = std::exp(std::lgamma((v + 1.0) / 2.0) - std::lgamma(v / 2.0)) / std::sqrt(v * 3.14159265358979323846);
+  for (auto i = 0; i < 8; ++i)
+  {
+    const auto density = normalization * std::pow(1.0 + t * t / v, -(v + 1.0) / 2.0);
+    const auto step    = (student_t_cdf(t, v) - p) / density;
+    t -= step;
+    if (std::abs(step) < 1e-12 * std::max(1.0, std::abs(t)))
+      break;
+  }
+  return t;
+}
+
+// Linearly interpolated percentile in [0, 100] of the values, which are partially reordered.
+template <typename type = double>
+type              select_percentile(std::vector<type>& values, const type percent)
+{
+  if (values.empty())
+    return std::numeric_limits<type>::quiet_NaN();
+
+  const auto position = std::clamp(percent, type(0), type(100)) / type(100) * static_cast<type>(values.size() - 1);
+  const auto lower    = static_cast<std::size_t>(position);
+  std::nth_element(values.begin(), values.begin() + lower, values.end());
+  if (lower + 1 == values.size())
+    return values[lower];
+  const auto upper    = *std::min_element(values.begin() + lower + 1, values.end());
+  return values[lower] + (position - static_cast<type>(lower)) * (upper - values[lower]);
+}
+
+// Linearly interpolated percentile in [0, 100] of the sorted values.
+template <typename type = double>
+type              sorted_percentile(const std::vector<type>& sorted, const type percent)
+{
+  if (sorted.empty())
+    return std::numeric_limits<type>::quiet_NaN();
+
+  const auto position = std::clamp(percent, type(0), type(100)) / type(100) * static_cast<type>(sorted.size() - 1);
+  const auto lower    = static_cast<std::size_t>(position);
+  if (lower + 1 == sorted.size())
+    return sorted[lower];
+  return sorted[lower] + (position - static_cast<type>(lower)) * (sorted[lower + 1] - sorted[lower]);
+}
+
+// Confidence interval of the mean or median of the values from the given number of bootstrap resamples. Each resample draws from its
+// own generator seeded by its index, hence the result does not depend on the number of threads the resamples are distributed over.
+template <typename type = double>
+interval<type>    bootstrap        (
+  const std::vector<type>& values                           , 
+  const estimator          estimator                        , 
+  const type               level     = type(0.95)           , 
+  const std::size_t        resamples = 1000                 , 
+  const bootstrap_method   method    = bootstrap_method::bca, 
+  const std::uint64_t      seed      = 0                    )
+{
+  const auto size = values.size();
+  if (size < 2 || resamples == 0)
+    return {std::numeric_limits<type>::quiet_NaN(), std::numeric_limits<type>::quiet_NaN()};
+
+  const auto estimate = [estimator] (std::vector<type>& sample)
+  {
+    if (estimator == bm::estimator::mean)
+      return std::accumulate(sample.begin(), sample.end(), type(0)) / static_cast<type>(sample.size());
+    return select_percentile(sample, type(50));
+  };
+
+  std::vector<type> replicates(resamples);
+  const auto resample = [&] (const std::size_t begin, const std::size_t end)
+  {
+    std::vector<type> sample(size);
+    std::uniform_int_distribution<std::size_t> distribution(0, size - 1);
+    for (auto i = begin; i < end; ++i)
+    {
+      std::mt19937_64 generator(seed ^ (0x9E3779B97F4A7C15ull * (i + 1)));
+      for (auto& value : sample)
+        value = values[distribution(generator)];
+      replicates[i] = estimate(sample);
+    }
+  };
+
+  // Threads are only worth their startup for about a million draws or more.
+  const auto threads = size * resamples < (std::size_t(1) << 20) ? std::size_t(1) : std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), resamples);
+  if (threads == 1)
+    resample(0, resamples);
+  else
+  {
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i)
+      workers.emplace_back(resample, resamples * i / threads, resamples * (i + 1) / threads);
+    for (auto& worker : workers)
+      worker.join();
+  }
+
+  auto lower = (1.0 - static_cast<double>(level)) / 2.0;
+  auto upper = 1.0 - lower;
+  if (method == bootstrap_method::bca)
+  {
+    std::vector<type> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    const auto observed = estimator == bm::estimator::mean ? std::accumulate(values.begin(), values.end(), type(0)) / static_cast<type>(size) : select_percentile(sorted, type(50));
+
+    const auto below = static_cast<double>(std::count_if(replicates.begin(), replicates.end(), [&] (const type value) { return value < observed; })) +
+                 0.5 * static_cast<double>(std::count     (replicates.begin(), replicates.end(), observed));
+    const auto bias  = normal_quantile(below / static_cast<double>(resamples));
+
+    // Leave-one-out estimates. The median without a value only depends on the rank of that value.
+    std::vector<double> jackknife(size);
+    const auto total = std::accumulate(values.begin(), values.end(), type(0));
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      if (estimator == bm::estimator::mean)
+        jackknife[i] = static_cast<double>((total - values[i]) / static_cast<type>(size - 1));
+      else
+      {
+        const auto rank = static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), values[i]) - sorted.begin());
+        const auto at   = [&] (const std::size_t index) { return static_cast<double>(sorted[index < rank ? index : index + 1]); };
+        const auto half = (size - 1) / 2;
+        jackknife[i] = (size - 1) % 2 == 1 ? at(half) : (at(half - 1) + at(half)) / 2.0;
+      }
+    }
+    const auto jackknife_mean = std::accumulate(jackknife.begin(), jackknife.end(), 0.0) / static_cast<double>(size);
+    double cubes = 0.0, squares = 0.0;
+    for (auto& value : jackknife)
+    {
+      const auto deviation = jackknife_mean - value;
+      squares += deviation * deviation;
+      cubes   += deviation * deviation * deviation;
+    }
+    const auto acceleration = squares > 0.0 ? cubes / (6.0 * std::pow(squares, 1.5)) : 0.0;
+
+    // An infinite bias means the observed estimate lies outside the bootstrap distribution, for which the percentiles are kept.
+    if (std::isfinite(bias))
+    {
+      const auto adjust = [&] (const double p)
+      {
+        const auto z = bias + normal_quantile(p);
+        return normal_cdf(bias + z / (1.0 - acceleration * z));
+      };
+      lower = adjust(lower);
+      upper = adjust(upper);
+    }
+  }
+  return {select_percentile(replicates, static_cast<type>(lower * 100.0)), select_percentile(replicates, static_cast<type>(upper * 100.0))};
+}
+
+// Single pass mean, variance (Welford), minimum and maximum, with Kahan compensated updates to stay accurate over millions of samples.
+template <typename type = double>
+class  accumulator
+{
+public:
+  constexpr void        add     (const type value)
+  {
+    minimum_ = count_ > 0 ? std::min(minimum_, value) : value;
+    maximum_ = count_ > 0 ? std::max(maximum_, value) : value;
+    ++count_;
+    const type delta = value - mean_;
+    compensated_add(mean_, delta / static_cast<type>(count_), mean_compensation_);
+    compensated_add(m2_  , delta * (value - mean_)          , m2_compensation_  );
+  }
+  // Combines the statistics of two disjoint sets of samples (Chan et al.).
+  constexpr void        merge   (const accumulator& that)
+  {
+    if (that.count_ == 0)
+      return;
+    if (count_ == 0)
+    {
+      *this = that;
+      return;
+    }
+
+    const auto count = count_ + that.count_;
+    const auto delta = that.mean() - mean();
+    mean_    = mean() + delta * static_cast<type>(that.count_) / static_cast<type>(count);
+    m2_      = m2_ + that.m2_ + delta * delta * static_cast<type>(count_) * static_cast<type>(that.count_) / static_cast<type>(count);
+    minimum_ = std::min(minimum_, that.minimum_);
+    maximum_ = std::max(maximum_, that.maximum_);
+    count_   = count;
+    mean_compensation_ = type(0);
+    m2_compensation_   = type(0);
+  }
+
+  constexpr std::size_t count   () const
+  {
+    return count_;
+  }
+  constexpr type        mean    () const
+  {
+    return count_ > 0 ? mean_ : std::numeric_limits<type>::quiet_NaN();
+  }
+  constexpr type        variance() const
+  {
+    return count_ > 0 ? m2_ / static_cast<type>(count_) : std::numeric_limits<type>::quiet_NaN();
+  }
+  constexpr type        min     () const
+  {
+    return count_ > 0 ? minimum_ : std::numeric_limits<type>::quiet_NaN();
+  }
+  constexpr type        max     () const
+  {
+    return count_ > 0 ? maximum_ : std::numeric_limits<type>::quiet_NaN();
+  }
+
+  // Restores the statistics of samples from their count, mean, variance, minimum and maximum, e.g. when reading them from a file.
+  static constexpr accumulator restore(const std::size_t count, const type mean, const type variance, const type min, const type max)
+  {
+    accumulator result;
+    if (count == 0)
+      return result;
+    result.count_   = count;
+    result.mean_    = mean;
+    result.m2_      = variance * static_cast<type>(count);
+    result.minimum_ = min;
+    result.maximum_ = max;
+    return result;
+  }
+
+protected:
+  static constexpr void compensated_add(type& sum, const type value, type& compensation)
+  {
+    const type corrected = value - compensation;
+    const type total     = sum + corrected;
+    compensation = (total - sum) - corrected;
+    sum          = total;
+  }
+
+  std::size_t count_             = 0;
+  type        mean_              = type(0);
+  type        m2_                = type(0);
+  type        mean_compensation_ = type(0);
+  type        m2_compensation_   = type(0);
+  type        minimum_           = type(0);
+  type        maximum_           = type(0);
+};
+
+// High dynamic range histogram with fixed memory. Values between lowest and highest are counted in buckets whose width is
+// within 10^-significant_digits of the value, values outside are clamped. A default constructed histogram has the layout of the
+// default options, and allocates its buckets on the first add.
+template <typename type = double>
+class  histogram
+{
+public:
+  histogram           () = default;
+  // Throws std::invalid_argument unless the lowest value (the unit of the buckets) is positive and the highest value is finite and
+  // within 2^62 units of it.
+  histogram           (const type lowest, const type highest, const std::uint32_t significant_digits = 3)
+  : lowest_(lowest), highest_(highest), significant_digits_(std::clamp<std::uint32_t>(significant_digits, 1, 5))
+  {
+    if (!valid_layout(static_cast<double>(lowest), static_cast<double>(highest)))
+      throw std::invalid_argument("The histogram requires a positive lowest value and a finite highest value within 2^62 times it.");
+
+    const auto largest_single_unit  = 2 * static_cast<std::int64_t>(std::pow(10, significant_digits_));
+    const auto sub_bucket_magnitude = static_cast<std::int32_t>(std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+    half_count_magnitude_ = std::max(sub_bucket_magnitude, 1) - 1;
+    half_count_           = std::int64_t(1) << half_count_magnitude_;
+    sub_bucket_mask_      = 2 * half_count_ - 1;
+    highest_unit_         = std::max(static_cast<std::int64_t>(std::ceil(static_cast<double>(highest_) / static_cast<double>(lowest_))), 2 * half_count_);
+
+    std::int32_t bucket_count      = 1;
+    std::int64_t smallest_untracked = 2 * half_count_;
+    while (smallest_untracked <= highest_unit_ && smallest_untracked <= std::numeric_limits<std::int64_t>::max() / 2)
+    {
+      smallest_untracked <<= 1;
+      ++bucket_count;
+    }
+    counts_.resize(static_cast<std::size_t>((bucket_count + 1) * half_count_));
+  }
+  histogram           (const histogram&  that) = default;
+  histogram           (      histogram&& temp) = default;
+ ~histogram           ()                       = default;
+  histogram& operator=(const histogram&  that) = default;
+  histogram& operator=(      histogram&& temp) = default;
+
+  void          add        (const type value, const std::uint64_t count = 1)
+  {
+    allocate();
+    const auto units = std::clamp(static_cast<std::int64_t>(static_cast<double>(value) / static_cast<double>(lowest_) + 0.5), std::int64_t(0), highest_unit_);
+    counts_[index(units)] += count;
+    total_                += count;
+  }
+  // Merges the counts of another histogram. Histograms with a different layout are merged bucket by bucket through add.
+  void          merge      (const histogram& that)
+  {
+    allocate();
+    if (lowest_ == that.lowest_ && highest_ == that.highest_ && significant_digits_ == that.significant_digits_)
+    {
+      for (std::size_t i = 0; i < counts_.size(); ++i)
+        counts_[i] += that.counts_[i];
+      total_ += that.total_;
+      return;
+    }
+    for (std::size_t i = 0; i < that.counts_.size(); ++i)
+      if (that.counts_[i] > 0)
+        add(that.value(i), that.counts_[i]);
+  }
+
+  std::uint64_t count      () const
+  {
+    return total_;
+  }
+  // Percentile in [0, 100], accurate to the bucket width.
+  type          percentile (const type percent) const
+  {
+    if (total_ == 0)
+      return std::numeric_limits<type>::quiet_NaN();
+
+    const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(static_cast<double>(std::clamp(percent, type(0), type(100))) / 100.0 * static_cast<double>(total_))));
+    std::uint64_t running = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i)
+    {
+      running += counts_[i];
+      if (running >= target)
+        return value(i);
+    }
+    return value(counts_.size() - 1);
+  }
+
+  type          lowest            () const
+  {
+    return lowest_;
+  }
+  type          highest           () const
+  {
+    return highest_;
+  }
+  std::uint32_t significant_digits() const
+  {
+    return significant_digits_;
+  }
+
+  // Compact binary representation: the layout followed by the counts as zigzag varints, runs of empty buckets encoded as negative lengths.
+  std::string   serialize  () const
+  {
+    std::string result;
+    append(result, static_cast<double>(lowest_ ));
+    append(result, static_cast<double>(highest_));
+    append(result, significant_digits_);
+
+    for (std::size_t i = 0; i < counts_.size();)
+    {
+      if (counts_[i] == 0)
+      {
+        std::int64_t run = 0;
+        while (i < counts_.size() && counts_[i] == 0)
+          ++run, ++i;
+        append_varint(result, zigzag(-run));
+      }
+      else
+        append_varint(result, zigzag(static_cast<std::int64_t>(counts_[i++])));
+    }
+    return result;
+  }
+  // Whether the data starts with a layout deserialize can rebuild: a positive lowest value (the unit of the buckets) and a finite
+  // highest value within 2^62 units of it. Guards against corrupt or hostile files, as the layout is otherwise divided by and allocated.
+  static bool      readable   (const std::string_view data)
+  {
+    if (data.size() < 2 * sizeof(double) + sizeof(std::uint32_t))
+      return false;
+    double lowest, highest;
+    std::memcpy(&lowest , data.data()                 , sizeof(double));
+    std::memcpy(&highest, data.data() + sizeof(double), sizeof(double));
+    return valid_layout(lowest, highest);
+  }
+  static histogram deserialize(const std::string& data)
+  {
+    std::size_t offset = 0;
+    const auto lowest             = read<double>       (data, offset);
+    const auto highest            = read<double>       (data, offset);
+    const auto significant_digits = read<std::uint32_t>(data, offset);
+
+    histogram result(static_cast<type>(lowest), static_cast<type>(highest), significant_digits);
+    for (std::size_t i = 0; offset < data.size() && i < result.counts_.size();)
+    {
+      const auto value = unzigzag(read_varint(data, offset));
+      if (value < 0)
+        i += static_cast<std::size_t>(-value);
+      else
+      {
+        result.counts_[i++] = static_cast<std::uint64_t>(value);
+        result.total_      += static_cast<std::uint64_t>(value);
+      }
+    }
+    return result;
+  }
+
+protected:
+  static bool          valid_layout(const double lowest, const double highest)
+  {
+    return std::isfinite(lowest) && std::isfinite(highest) && static_cast<type>(lowest) > type(0) && highest / lowest < 0x1p62;
+  }
+  // Allocates the buckets of a default constructed histogram.
+  void                 allocate    ()
+  {
+    if (counts_.empty())
+      *this = histogram(lowest_, highest_, significant_digits_);
+  }
+  static std::int32_t  floor_log2  (const std::uint64_t value)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    std::int32_t result = 0;
+    for (auto remainder = value; remainder > 1; remainder >>= 1)
+      ++result;
+    return result;
+#endif
+  }
+  std::size_t          index       (const std::int64_t units) const
+  {
+    const auto bucket     = floor_log2(static_cast<std::uint64_t>(units | sub_bucket_mask_)) - half_count_magnitude_;
+    const auto sub_bucket = units >> bucket;
+    return static_cast<std::size_t>((static_cast<std::int64_t>(bucket) << half_count_magnitude_) + sub_bucket);
+  }
+  // Midpoint of the bucket at the given index.
+  type                 value       (const std::size_t index) const
+  {
+    auto bucket     = static_cast<std::int64_t>(index >> half_count_magnitude_) - 1;
+    auto sub_bucket = static_cast<std::int64_t>(index & static_cast<std::size_t>(half_count_ - 1)) + half_count_;
+    if (bucket < 0)
+    {
+      sub_bucket -= half_count_;
+      bucket      = 0;
+    }
+    const auto lowest_units = sub_bucket << bucket;
+    const auto width        = std::int64_t(1) << bucket;
+    return static_cast<type>((static_cast<double>(lowest_units) + static_cast<double>(width - 1) / 2.0) * static_cast<double>(lowest_));
+  }
+
+  template <typename value_type>
+  static void          append       (std::string& data, const value_type value)
+  {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value_type));
+  }
+  static void          append_varint(std::string& data, std::uint64_t value)
+  {
+    do
+    {
+      const auto byte = static_cast<char>(value & 0x7F);
+      value >>= 7;
+      data.push_back(value != 0 ? static_cast<char>(byte | 0x80) : byte);
+    } while (value != 0);
+  }
+  template <typename value_type>
+  static value_type    read         (const std::string& data, std::size_t& offset)
+  {
+    value_type value {};
+    if (offset + sizeof(value_type) <= data.size())
+      std::memcpy(&value, data.data() + offset, sizeof(value_type));
+    offset += sizeof(value_type);
+    return value;
+  }
+  static std::uint64_t read_varint  (const std::string& data, std::size_t& offset)
+  {
+    std::uint64_t value = 0;
+    for (std::uint32_t shift = 0; offset < data.size() && shift < 64; shift += 7)
+    {
+      const auto byte = static_cast<std::uint8_t>(data[offset++]);
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0)
+        break;
+    }
+    return value;
+  }
+  static std::uint64_t zigzag       (const std::int64_t  value)
+  {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+  }
+  static std::int64_t  unzigzag     (const std::uint64_t value)
+  {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+  }
+
+  type                       lowest_               = type(1e-3);
+  type                       highest_              = type(1e+6);
+  std::uint32_t              significant_digits_   = 3;
+  std::int32_t               half_count_magnitude_ = 0;
+  std::int64_t               half_count_           = 1;
+  std::int64_t               sub_bucket_mask_      = 1;
+  std::int64_t               highest_unit_         = 0;
+  std::uint64_t              total_                = 0;
+  std::vector<std::uint64_t> counts_               ;
+};
+
+// Number of outliers on either side of the distribution.
+struct outliers
+{
+  constexpr std::size_t mild () const
+  {
+    return low_mild   + high_mild  ;
+  }
+  constexpr std::size_t severe() const
+  {
+    return low_severe + high_severe;
+  }
+  constexpr std::size_t total () const
+  {
+    return mild() + severe();
+  }
+
+  std::size_t low_severe  = 0;
+  std::size_t low_mild    = 0;
+  std::size_t high_mild   = 0;
+  std::size_t high_severe = 0;
+};
+
+// Number of run columns of each kind in a csv. Records with fewer samples leave the remaining cells empty.
+struct csv_layout
+{
+  std::size_t values             = 0;
+  std::size_t thread_cpu_values  = 0;
+  std::size_t process_cpu_values = 0;
+  std::size_t threads            = 0;
+};
+
+// Buffered output to a stream, e.g. of csv or json. Numbers are formatted by std::to_chars, in the shortest representation which reads back exactly.
+class  buffered_writer
+{
+public:
+  explicit buffered_writer   (std::ostream& stream, const std::size_t capacity = std::size_t(1) << 16) 
+  : stream_(stream), buffer_(std::max<std::size_t>(capacity, 2 * maximum_length))
+  {
+
+  }
+  buffered_writer           (const buffered_writer&  that) = delete;
+  buffered_writer           (      buffered_writer&& temp) = delete;
+ ~buffered_writer           ()
+  {
+    flush();
+  }
+  buffered_writer& operator=(const buffered_writer&  that) = delete;
+  buffered_writer& operator=(      buffered_writer&& temp) = delete;
+
+  buffered_writer& operator<<(const std::string_view text)
+  {
+    if (text.size() > buffer_.size() - size_)
+    {
+      flush();
+      if (text.size() > buffer_.size())
+      {
+        stream_.write(text.data(), static_cast<std::streamsize>(text.size()));
+        return *this;
+      }
+    }
+    std::memcpy(buffer_.data() + size_, text.data(), text.size());
+    size_ += text.size();
+    return *this;
+  }
+  buffered_writer& operator<<(const char             character)
+  {
+    if (size_ == buffer_.size())
+      flush();
+    buffer_[size_++] = character;
+    return *this;
+  }
+  template <typename value_type, typename = std::enable_if_t<std::is_arithmetic_v<value_type> && !std::is_same_v<value_type, bool>>>
+  buffered_writer& operator<<(const value_type       value)
+  {
+    if (buffer_.size() - size_ < maximum_length)
+      flush();
+    const auto begin = buffer_.data() + size_;
+#ifndef __cpp_lib_to_chars
+    if constexpr (std::is_floating_point_v<value_type>)
+      size_ += static_cast<std::size_t>(std::snprintf(begin, maximum_length, "%.*Lg", std::numeric_limits<value_type>::max_digits10, static_cast<long double>(value)));
+    else
+#endif
+    size_ += static_cast<std::size_t>(std::to_chars(begin, begin + maximum_length, value).ptr - begin);
+    return *this;
+  }
+
+  void             flush     ()
+  {
+    stream_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+  }
+
+protected:
+  static constexpr std::size_t maximum_length = 64;
+
+  std::ostream&     stream_;
+  std::vector<char> buffer_;
+  std::size_t       size_   = 0;
+};
+
+// Writes the text as a json string, escaping quotes, backslashes and control characters.
+inline void       write_json_string(buffered_writer& writer, const std::string_view text)
+{
+  static constexpr char hexadecimal[] = "0123456789abcdef";
+  writer << '"';
+  for (const auto character : text)
+  {
+    const auto code = static_cast<unsigned char>(character);
+    if      (character == '"' || character == '\\')
+      writer << '\\' << character;
+    else if (code < 0x20)
+      writer << "\\u00" << hexadecimal[code >> 4] << hexadecimal[code & 0x0F];
+    else
+      writer << character;
+  }
+  writer << '"';
+}
+// Writes the text as a csv field, quoted with its quotes doubled if it contains a separator, quote or line break (RFC 4180).
+template <typename writer_type>
+void              write_csv_field  (writer_type& writer, const std::string_view text)
+{
+  if (text.find_first_of(",\"\r\n") == std::string_view::npos)
+  {
+    writer << text;
+    return;
+  }
+  writer << '"';
+  for (const auto character : text)
+  {
+    if (character == '"')
+      writer << '"';
+    writer << character;
+  }
+  writer << '"';
+}
+// Writes the number, or null if it is not finite, which json cannot represent.
+template <typename type>
+void              write_json_number(buffered_writer& writer, const type value)
+{
+  if constexpr (std::is_floating_point_v<type>)
+    if (!std::isfinite(value))
+    {
+      writer << "null";
+      return;
+    }
+  writer << value;
+}
+
+// Description of the machine, as in the context block of Google Benchmark. The caches, load average and frequency scaling are only
+// queried on Linux, the frequency falls back to the one of the time stamp counter.
+struct system_context
+{
+  struct cache
+  {
+    std::string type       ;
+    std::size_t level      = 0;
+    std::size_t size       = 0;
+    std::size_t num_sharing = 0;
+  };
+
+  static system_context query     ()
+  {
+    system_context result;
+
+    const auto now = std::time(nullptr);
+    std::tm local {};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char date[64] {};
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", &local);
+    result.date = date;
+    if (result.date.size() > 5 && (result.date[result.date.size() - 5] == '+' || result.date[result.date.size() - 5] == '-'))
+      result.date.insert(result.date.size() - 2, ":");
+
+#if defined(_WIN32)
+    char  name[256] {};
+    DWORD length = sizeof(name);
+    if (GetComputerNameA(name, &length))
+      result.host_name = std::string(name, length);
+    char  path[1024] {};
+    result.executable = std::string(path, GetModuleFileNameA(nullptr, path, sizeof(path)));
+#elif defined(BM_MMAP_SUPPORT)
+    char name[256] {};
+    if (gethostname(name, sizeof(name) - 1) == 0)
+      result.host_name = name;
+#endif
+
+    result.num_cpus = std::thread::hardware_concurrency();
+#ifdef BM_TSC_SUPPORT
+    if (tsc_clock::invariant())
+      result.mhz_per_cpu = tsc_clock::frequency() / 1e6;
+#endif
+
+#ifdef __linux__
+    char path[4096] {};
+    const auto size = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (size > 0)
+      result.executable = std::string(path, static_cast<std::size_t>(size));
+
+    const auto read = [ ] (const std::string& filepath)
+    {
+      std::ifstream stream(filepath);
+      std::string   line  ;
+      std::getline(stream, line);
+      return line;
+    };
+
+    std::ifstream cpu_information("/proc/cpuinfo");
+    for (std::string line; std::getline(cpu_information, line);)
+      if (line.compare(0, 7, "cpu MHz") == 0 && line.find(':') != std::string::npos)
+      {
+        result.mhz_per_cpu = std::strtod(line.c_str() + line.find(':') + 1, nullptr);
+        break;
+      }
+
+    const auto governor = read("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+    result.cpu_scaling_enabled = !governor.empty() && governor != "performance";
+
+    for (auto i = 0;; ++i)
+    {
+      const auto directory = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i) + "/";
+      const auto level     = read(directory + "level");
+      if (level.empty())
+        break;
+
+      cache entry;
+      entry.type  = read(directory + "type");
+      entry.level = static_cast<std::size_t>(std::strtoull(level.c_str(), nullptr, 10));
+      char* suffix;
+      const auto size  = read(directory + "size");
+      entry.size  = static_cast<std::size_t>(std::strtoull(size.c_str(), &suffix, 10));
+      if      (*suffix == 'K')
+        entry.size <<= 10;
+      else if (*suffix == 'M')
+        entry.size <<= 20;
+      for (const auto character : read(directory + "shared_cpu_map"))
+        if (std::isxdigit(static_cast<unsigned char>(character)))
+        {
+          const auto digit = std::isdigit(static_cast<unsigned char>(character)) ? character - '0' : std::tolower(character) - 'a' + 10;
+          entry.num_sharing += static_cast<std::size_t>((digit & 1) + (digit >> 1 & 1) + (digit >> 2 & 1) + (digit >> 3 & 1));
+        }
+      result.caches.push_back(entry);
+    }
+
+    std::istringstream load(read("/proc/loadavg"));
+    for (double value; result.load_avg.size() < 3 && load >> value;)
+      result.load_avg.push_back(value);
+#endif
+    return result;
+  }
+
+  void                  write_json(buffered_writer& writer) const
+  {
+    writer << "  \"context\": {\n";
+    writer << "    \"date\": "                ; write_json_string(writer, date      ); writer << ",\n";
+    writer << "    \"host_name\": "           ; write_json_string(writer, host_name ); writer << ",\n";
+    writer << "    \"executable\": "          ; write_json_string(writer, executable); writer << ",\n";
+    writer << "    \"num_cpus\": "            << num_cpus << ",\n";
+    writer << "    \"mhz_per_cpu\": "         << static_cast<std::uint64_t>(std::llround(mhz_per_cpu)) << ",\n";
+    writer << "    \"cpu_scaling_enabled\": " << (cpu_scaling_enabled ? "true" : "false") << ",\n";
+    writer << "    \"caches\": [";
+    for (std::size_t i = 0; i < caches.size(); ++i)
+    {
+      writer << (i == 0 ? "\n" : ",\n") << "      {\n";
+      writer << "        \"type\": "; write_json_string(writer, caches[i].type); writer << ",\n";
+      writer << "        \"level\": "       << caches[i].level       << ",\n";
+      writer << "        \"size\": "        << caches[i].size        << ",\n";
+      writer << "        \"num_sharing\": " << caches[i].num_sharing << "\n";
+      writer << "      }";
+    }
+    writer << (caches.empty() ? "],\n" : "\n    ],\n");
+    writer << "    \"load_avg\": [";
+    for (std::size_t i = 0; i < load_avg.size(); ++i)
+      writer << (i == 0 ? "" : ",") << load_avg[i];
+    writer << "],\n";
+#ifdef NDEBUG
+    writer << "    \"library_build_type\": \"release\",\n";
+#else
+    writer << "    \"library_build_type\": \"debug\",\n";
+#endif
+    writer << "    \"json_schema_version\": 1\n";
+    writer << "  }";
+  }
+
+  std::string         date               ;
+  std::string         host_name          ;
+  std::string         executable         ;
+  unsigned            num_cpus           = 0;
+  double              mhz_per_cpu        = 0.0;
+  bool                cpu_scaling_enabled = false;
+  std::vector<cache>  caches             ;
+  std::vector<double> load_avg           ;
+};
+
+// Value derived from the samples of an owner (e.g. a record) by its const queries. Queries are guarded, hence concurrent readers of the
+// owner are safe, and copies read the value of their source under its lock. Clearing and moving are modifications of the owner, as is
+// adding samples, hence unguarded; moving leaves the source cleared.
+template <typename value_type>
+class  guarded_cache
+{
+public:
+  guarded_cache           () = default;
+  guarded_cache           (const guarded_cache&  that) : value_(that.load())
+  {
+
+  }
+  guarded_cache           (      guarded_cache&& temp) noexcept : value_(std::exchange(temp.value_, value_type()))
+  {
+
+  }
+  guarded_cache& operator=(const guarded_cache&  that)
+  {
+    auto value = that.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = std::move(value);
+    return *this;
+  }
+  guarded_cache& operator=(      guarded_cache&& temp) noexcept
+  {
+    if (this != &temp)
+      value_ = std::exchange(temp.value_, value_type());
+    return *this;
+  }
+
+  void clear() noexcept
+  {
+    value_ = value_type();
+  }
+
+protected:
+  value_type load() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return value_;
+  }
+
+  mutable std::mutex mutex_;
+  mutable value_type value_;
+};
+
+// Sorted copy of the values of a record, built at most once per change in the samples and shared by the copies of the record.
+template <typename type = double>
+class  sorted_cache : public guarded_cache<std::shared_ptr<const std::vector<type>>>
+{
+public:
+  // The values are sorted unless a sorted copy of the same size is cached, hence appending or removing values is detected.
+  std::shared_ptr<const std::vector<type>> get  (const std::vector<type>& values) const
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (!this->value_ || this->value_->size() != values.size())
+    {
+      auto sorted = std::make_shared<std::vector<type>>(values);
+      std::sort(sorted->begin(), sorted->end());
+      this->value_ = std::move(sorted);
+    }
+    return this->value_;
+  }
+  // The cached sorted copy if it matches the size of the values, else null.
+  std::shared_ptr<const std::vector<type>> peek (const std::vector<type>& values) const
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->value_ && this->value_->size() == values.size() ? this->value_ : nullptr;
+  }
+};
+
+// Statistics of the values within the outlier fences of a record, cached for a key identifying the samples (their number).
+template <typename type = double>
+struct filtered_entry
+{
+  std::pair<std::size_t, std::size_t> key       {std::numeric_limits<std::size_t>::max(), std::numeric_limits<std::size_t>::max()};
+  accumulator<type>                   statistics;
+};
+template <typename type = double>
+class  filtered_cache : public guarded_cache<filtered_entry<type>>
+{
+public:
+  using key_type = std::pair<std::size_t, std::size_t>;
+
+  // Computes the statistics through the function unless cached for the key.
+  template <typename function_type>
+  accumulator<type> get  (const key_type& key, function_type&& function) const
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->value_.key != key)
+      this->value_ = {key, function()};
+    return this->value_.statistics;
+  }
+};
+
+// Index of records by name. The records may be renamed, replaced or reordered in place, hence a miss is confirmed by a scan, which
+// rebuilds the index if it finds the name.
+class  name_index : public guarded_cache<std::unordered_map<std::string, std::size_t>>
+{
+public:
+  // Returns the index of the first record with the given name, or records.size() if there is none.
+  template <typename records_type>
+  std::size_t find   (const records_type& records, const std::string& name) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto iterator = value_.find(name);
+    if (iterator != value_.end() && iterator->second < records.size() && records[iterator->second].name == name)
+      return iterator->second;
+
+    const auto record = std::find_if(records.begin(), records.end(), [&name] (const auto& record) { return record.name == name; });
+    if (iterator != value_.end() || record != records.end())
+    {
+      value_.clear  ();
+      value_.reserve(records.size());
+      for (std::size_t i = 0; i < records.size(); ++i)
+        value_.emplace(records[i].name, i);
+    }
+    return static_cast<std::size_t>(std::distance(records.begin(), record));
+  }
+  void        insert (const std::string& name, const std::size_t index)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_.emplace(name, index);
+  }
+  void        reserve(const std::size_t count)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_.reserve(count);
+  }
+};
+
+template <typename type = double>
+struct sample
+{
+  type                         wall        = type(0);
+  std::optional<type>          thread_cpu  ;
+  std::optional<type>          process_cpu ;
+  std::optional<type>          start       ; // Since the timeline origin, if the timeline is enabled.
+  std::optional<std::uint32_t> thread      ; // Index (see thread_index) of the recording thread, if recorded by a session_recorder.
+};
+
+template <typename type = double>
+struct record
+{
+  record(std::string name = std::string(), std::vector<type> values = std::vector<type>()) : name(std::move(name)), values(std::move(values))
+  {
+
+  }
+
+  // Stores a sample according to the storage and updates the running statistics. The processor times are kept alongside the values,
+  // hence they are discarded when storing a histogram.
+  void                  add               (const bm::sample<type>& sample)
+  {
+    auto slot = values.size();
+    if      (storage == bm::storage::histogram)
+    {
+      histogram.add(sample.wall);
+      slot = std::numeric_limits<std::size_t>::max();
+    }
+    else if (storage == bm::storage::reservoir && values.size() >= reservoir_size)
+    {
+      slot = static_cast<std::size_t>(std::uniform_int_distribution<std::uint64_t>(0, statistics.count())(random_));
+      if (slot < reservoir_size)
+        values[slot] = sample.wall;
+      else
+        slot = std::numeric_limits<std::size_t>::max();
+    }
+    else
+      values.push_back(sample.wall);
+
+    if (sample.thread_cpu )
+      place(thread_cpu_values , slot, *sample.thread_cpu );
+    if (sample.process_cpu)
+      place(process_cpu_values, slot, *sample.process_cpu);
+    if (sample.thread     )
+      place(threads           , slot, *sample.thread     );
+    statistics.add(sample.wall);
+    sorted_.clear();
+  }
+  void                  add               (const type value)
+  {
+    bm::sample<type> sample;
+    sample.wall = value;
+    add(sample);
+  }
+  // Combines the samples of another record. The result uses the more compact storage of the two (histogram, then reservoir, then values).
+  void                  merge             (const record& that)
+  {
+    const auto that_statistics = that.current_statistics();
+    if      (that.storage == bm::storage::histogram && storage != bm::storage::histogram)
+    {
+      auto converted = bm::histogram<type>(that.histogram.lowest(), that.histogram.highest(), that.histogram.significant_digits());
+      for (auto& value : values)
+        converted.add(value, weight());
+      histogram = std::move(converted);
+      storage   = bm::storage::histogram;
+    }
+    else if (that.storage == bm::storage::reservoir && storage == bm::storage::values)
+    {
+      storage        = bm::storage::reservoir;
+      reservoir_size = that.reservoir_size;
+    }
+
+    if      (storage == bm::storage::histogram)
+    {
+      for (auto& value : that.values)
+        histogram.add(value, that.weight());
+      if (that.storage == bm::storage::histogram)
+        histogram.merge(that.histogram);
+      values            .clear();
+      thread_cpu_values .clear();
+      process_cpu_values.clear();
+      threads           .clear();
+    }
+    else if (storage == bm::storage::reservoir)
+      resample(that, that_statistics.count());
+    else
+    {
+      values            .insert(values            .end(), that.values            .begin(), that.values            .end());
+      thread_cpu_values .insert(thread_cpu_values .end(), that.thread_cpu_values .begin(), that.thread_cpu_values .end());
+      process_cpu_values.insert(process_cpu_values.end(), that.process_cpu_values.begin(), that.process_cpu_values.end());
+      threads           .insert(threads           .end(), that.threads           .begin(), that.threads           .end());
+    }
+
+    statistics.merge(that_statistics);
+    exclusive_statistics.merge(that.exclusive_statistics);
+    sorted_.clear();
+  }
+  // Recomputes the statistics from the values and drops the cached orderings. Required after modifying the values in place, since only
+  // appending or removing values is detected.
+  void                  invalidate        ()
+  {
+    if (storage == bm::storage::values)
+    {
+      statistics = accumulator<type>();
+      for (auto& value : values)
+        statistics.add(value);
+    }
+    sorted_.clear();
+    filtered_.clear();
+  }
+
+  // Number of samples the statistics below are computed from.
+  constexpr std::size_t count             () const
+  {
+    return reported_statistics().count();
+  }
+  constexpr type        mean              () const
+  {
+    return reported_statistics().mean();
+  }
+  constexpr type        variance          () const
+  {
+    return reported_statistics().variance();
+  }
+  constexpr type        standard_deviation() const
+  {
+    return std::sqrt(variance());
+  }
+  // Confidence interval of the mean at the given level, from the Student t distribution. Undefined for less than two samples.
+  interval<type>        confidence_interval(const type level = type(0.95)) const
+  {
+    const auto statistics = reported_statistics();
+    if (statistics.count() < 2)
+      return {std::numeric_limits<type>::quiet_NaN(), std::numeric_limits<type>::quiet_NaN()};
+    const auto degrees = static_cast<double>(statistics.count() - 1);
+    const auto error   = static_cast<type>(student_t_quantile(0.5 + static_cast<double>(level) / 2.0, degrees)) * std::sqrt(statistics.variance() / static_cast<type>(degrees));
+    return {statistics.mean() - error, statistics.mean() + error};
+  }
+  // Standard error of the mean divided by the mean. Undefined for less than two samples.
+  constexpr type        relative_standard_error() const
+  {
+    const auto statistics = reported_statistics();
+    if (statistics.count() < 2)
+      return std::numeric_limits<type>::quiet_NaN();
+    return std::sqrt(statistics.variance() / static_cast<type>(statistics.count() - 1)) / std::abs(statistics.mean());
+  }
+  constexpr type        min               () const
+  {
+    return reported_statistics().min();
+  }
+  constexpr type        max               () const
+  {
+    return reported_statistics().max();
+  }
+
+  // Linearly interpolated percentile in [0, 100], within a sorted copy of the values which is cached until the samples change.
+  // Accurate to the bucket width when storing a histogram.
+  constexpr type        percentile        (const type percent) const
+  {
+    if (storage == bm::storage::histogram)
+      return histogram.percentile(percent);
+    return sorted_percentile(*sorted_.get(values), percent);
+  }
+  constexpr type        median            () const
+  {
+    return percentile(type(50));
+  }
+  constexpr type        interquartile_range() const
+  {
+    return percentile(type(75)) - percentile(type(25));
+  }
+  // Median of the absolute deviations from the median. Requires the values, as do the estimators and the classification below.
+  // The deviations below and above the median each increase outwards from it in the sorted values, hence are merged up to their median.
+  type                  median_absolute_deviation() const
+  {
+    const auto  cache  = sorted_.get(values);
+    const auto& sorted = *cache;
+    if (sorted.empty())
+      return std::numeric_limits<type>::quiet_NaN();
+
+    const auto  center = sorted_percentile(sorted, type(50));
+    auto        right  = static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), center) - sorted.begin());
+    auto        left   = right;
+    const auto  next   = [&]
+    {
+      if (left == 0 || (right < sorted.size() && sorted[right] - center < center - sorted[left - 1]))
+        return sorted[right++] - center;
+      return center - sorted[--left];
+    };
+    for (std::size_t i = 0; i < (sorted.size() - 1) / 2; ++i)
+      next();
+    const auto  lower  = next();
+    return sorted.size() % 2 == 1 ? lower : (lower + next()) / type(2);
+  }
+  // Mean of the values remaining after discarding the given proportion of the smallest and of the largest values.
+  type                  trimmed_mean      (const type proportion = type(0.1)) const
+  {
+    if (values.empty())
+      return std::numeric_limits<type>::quiet_NaN();
+    const auto  cache   = sorted_.get(values);
+    const auto& sorted  = *cache;
+
+    const auto trimmed = std::min(static_cast<std::size_t>(std::clamp(proportion, type(0), type(0.5)) * static_cast<type>(sorted.size())), (sorted.size() - 1) / 2);
+    return std::accumulate(sorted.begin() + trimmed, sorted.end() - trimmed, type(0)) / static_cast<type>(sorted.size() - 2 * trimmed);
+  }
+  // Median of the pairwise averages (x_i + x_j) / 2, i <= j. Selected by bisecting on their value, each step counting the averages
+  // below it in a single pass over the sorted values, hence avoids forming the n (n + 1) / 2 averages.
+  type                  hodges_lehmann    () const
+  {
+    if (values.empty())
+      return std::numeric_limits<type>::quiet_NaN();
+    const auto  cache    = sorted_.get(values);
+    const auto& order    = *cache;
+
+    const auto size      = order.size();
+    const auto count     = [&] (const type sum)
+    {
+      std::uint64_t result = 0;
+      auto          j      = size;
+      for (std::size_t i = 0; i < size; ++i)
+      {
+        while (j > i && order[i] + order[j - 1] > sum)
+          --j;
+        if (j <= i)
+          break;
+        result += j - i;
+      }
+      return result;
+    };
+    // Smallest pairwise sum of which at least rank are less than or equal.
+    const auto select    = [&] (const std::uint64_t rank)
+    {
+      auto lower = 2 * order.front(), upper = 2 * order.back();
+      if (count(lower) >= rank)
+        return lower;
+      for (auto i = 0; i < 256; ++i)
+      {
+        const auto middle = lower + (upper - lower) / 2;
+        if (middle <= lower || middle >= upper)
+          break;
+        (count(middle) >= rank ? upper : lower) = middle;
+      }
+      return upper;
+    };
+    const auto pairs     = static_cast<std::uint64_t>(size) * (size + 1) / 2;
+    const auto sum       = pairs % 2 == 1 ? select(pairs / 2 + 1) : (select(pairs / 2) + select(pairs / 2 + 1)) / 2;
+    return sum / 2;
+  }
+  bm::outliers          outliers          (const outlier_method method = outlier_method::tukey) const
+  {
+    bm::outliers result;
+    if (method == outlier_method::none || values.empty())
+      return result;
+
+    const auto bounds = fences(method);
+    for (auto& value : values)
+    {
+      if      (value < bounds[0]) ++result.low_severe ;
+      else if (value < bounds[1]) ++result.low_mild   ;
+      else if (value > bounds[3]) ++result.high_severe;
+      else if (value > bounds[2]) ++result.high_mild  ;
+    }
+    return result;
+  }
+
+  // Bootstrap confidence interval of the mean or median from the given number of resamples of the values. Undefined when storing a
+  // histogram, and describes the retained values only when storing a reservoir.
+  interval<type>        bootstrap_interval(const bm::estimator estimator, const type level = type(0.95), const bootstrap_method method = bootstrap_method::bca, const std::size_t resamples = 1000) const
+  {
+    return bootstrap(values, estimator, level, resamples, method);
+  }
+                                                              
+  constexpr csv_layout  layout            () const
+  {
+    return {values.size(), thread_cpu_values.size(), process_cpu_values.size(), threads.size()};
+  }
+  constexpr std::string to_string         () const
+  {
+    return to_string(layout());
+  }
+  constexpr std::string to_string         (const csv_layout& layout) const
+  {
+    std::ostringstream stream;
+    {
+      buffered_writer writer(stream);
+      write_row(writer, layout);
+    }
+    return stream.str();
+  }
+  constexpr std::string header            () const
+  {
+    return header(layout());
+  }
+  static    std::string header            (const csv_layout& layout)
+  {
+    std::ostringstream stream;
+    {
+      buffered_writer writer(stream);
+      write_header(writer, layout);
+    }
+    return stream.str();
+  }
+  constexpr void        to_csv            (const std::string& filepath) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    write_header(writer, layout());
+    writer << '\n';
+    write_row   (writer, layout());
+  }
+  // Writes the row of the record, with the run columns padded to the layout, without building it in memory first.
+  void                  write_row         (buffered_writer& writer, const csv_layout& layout) const
+  {
+    write_csv_field(writer, name);
+    writer << ',';
+    write_csv_field(writer, unit);
+    writer << ',';
+    for (auto& value : values)
+      writer << value << ',';
+    for (auto i = values.size(); i < layout.values; ++i)
+      writer << ',';
+    const auto statistics = reported_statistics();
+    writer << statistics.mean() << ',' << statistics.variance() << ',' << std::sqrt(statistics.variance()) << ',' << statistics.min() << ',' << statistics.max() << ',';
+    // The percentiles are read from the cached sorted copy if any, else from a sorted copy released after the row.
+    auto sorted = sorted_.peek(values);
+    if (!sorted && storage != bm::storage::histogram)
+    {
+      auto copy = std::make_shared<std::vector<type>>(values);
+      std::sort(copy->begin(), copy->end());
+      sorted = std::move(copy);
+    }
+    const auto order      = [&] (const type percent) { return storage == bm::storage::histogram ? histogram.percentile(percent) : sorted_percentile(*sorted, percent); };
+    writer << order(type(50)) << ',' << order(type(75)) - order(type(25)) << ',';
+    writer << order(type(90)) << ',' << order(type(99)) << ',' << order(type(99.9)) << ',';
+    if (bootstrap_resamples > 0)
+    {
+      const auto mean_interval   = bootstrap_interval(estimator::mean  , type(0.95), bootstrap_method::bca, bootstrap_resamples);
+      const auto median_interval = bootstrap_interval(estimator::median, type(0.95), bootstrap_method::bca, bootstrap_resamples);
+      writer << mean_interval.lower << ',' << mean_interval.upper << ',' << median_interval.lower << ',' << median_interval.upper;
+    }
+    else
+      writer << ",,,";
+    for (auto& value : thread_cpu_values)
+      writer << ',' << value;
+    for (auto i = thread_cpu_values.size(); i < layout.thread_cpu_values; ++i)
+      writer << ',';
+    for (auto& value : process_cpu_values)
+      writer << ',' << value;
+    for (auto i = process_cpu_values.size(); i < layout.process_cpu_values; ++i)
+      writer << ',';
+    for (auto& thread : threads)
+      writer << ',' << thread;
+    for (auto i = threads.size(); i < layout.threads; ++i)
+      writer << ',';
+  }
+  static void           write_header      (buffered_writer& writer, const csv_layout& layout)
+  {
+    writer << "name,unit,";
+    for (std::size_t i = 0; i < layout.values; ++i)
+      writer << "run_" << i << ',';
+    writer << "mean,variance,standard deviation,min,max,median,interquartile range,90th percentile,99th percentile,99.9th percentile,";
+    writer << "mean lower bound,mean upper bound,median lower bound,median upper bound";
+    for (std::size_t i = 0; i < layout.thread_cpu_values; ++i)
+      writer << ",thread_cpu_run_" << i;
+    for (std::size_t i = 0; i < layout.process_cpu_values; ++i)
+      writer << ",process_cpu_run_" << i;
+    for (std::size_t i = 0; i < layout.threads; ++i)
+      writer << ",thread_run_" << i;
+  }
+  // Writes a json in the schema of Google Benchmark (see write_json).
+  void                  to_json           (const std::string& filepath, const bool aggregates_only = false) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "{\n";
+    system_context::query().write_json(writer);
+    writer << ",\n  \"benchmarks\": [\n";
+    write_json(writer, name, 0, 0, aggregates_only);
+    writer << "\n  ]\n}\n";
+  }
+  // Writes the entries of the record in the benchmarks array of Google Benchmark: each sample as a repetition (unless aggregates_only)
+  // of batch_size iterations, followed by the mean, median, stddev and cv aggregates. The cpu_time is the thread processor time if
+  // captured, else the process processor time if captured, else the wall time. Units other than ns, us, ms and s are converted to s.
+  void                  write_json        (buffered_writer& writer, const std::string& run_name, const std::size_t family_index, const std::size_t instance_index, const bool aggregates_only = false) const
+  {
+    const auto& cpu_values = !thread_cpu_values.empty() ? thread_cpu_values : !process_cpu_values.empty() ? process_cpu_values : values;
+    const auto  count      = std::max<std::size_t>(values.size(), current_statistics().count());
+
+    auto        time_unit  = unit.empty() ? std::string("ms") : unit;
+    auto        scale      = type(1);
+    if (time_unit != "ns" && time_unit != "us" && time_unit != "ms" && time_unit != "s")
+    {
+      scale     = static_cast<type>(seconds_per_unit(unit));
+      time_unit = "s";
+    }
+
+    const auto entry = [&] (const std::string& suffix, const std::size_t index, const char* aggregate, const char* aggregate_unit, const std::size_t iterations, const type real_time, const type cpu_time)
+    {
+      writer << "    {\n";
+      writer << "      \"name\": "; write_json_string(writer, run_name + suffix); writer << ",\n";
+      writer << "      \"family_index\": "              << family_index   << ",\n";
+      writer << "      \"per_family_instance_index\": " << instance_index << ",\n";
+      writer << "      \"run_name\": "; write_json_string(writer, run_name); writer << ",\n";
+      writer << "      \"run_type\": \"" << (aggregate ? "aggregate" : "iteration") << "\",\n";
+      writer << "      \"repetitions\": " << count << ",\n";
+      if (aggregate)
+      {
+        writer << "      \"threads\": 1,\n";
+        writer << "      \"aggregate_name\": \"" << aggregate      << "\",\n";
+        writer << "      \"aggregate_unit\": \"" << aggregate_unit << "\",\n";
+      }
+      else
+      {
+        writer << "      \"repetition_index\": " << index << ",\n";
+        writer << "      \"threads\": 1,\n";
+        if (index < threads.size())
+          writer << "      \"thread_index\": " << threads[index] << ",\n";
+      }
+      writer << "      \"iterations\": " << iterations << ",\n";
+      writer << "      \"real_time\": "; write_json_number(writer, real_time); writer << ",\n";
+      writer << "      \"cpu_time\": " ; write_json_number(writer, cpu_time ); writer << ",\n";
+      writer << "      \"time_unit\": \"" << time_unit << "\"\n";
+      writer << "    }";
+    };
+
+    if (!aggregates_only)
+      for (std::size_t i = 0; i < values.size(); ++i)
+      {
+        entry("", i, nullptr, nullptr, batch_size, values[i] * scale, (i < cpu_values.size() ? cpu_values[i] : values[i]) * scale);
+        writer << ",\n";
+      }
+
+    // Google Benchmark reports the sample standard deviation.
+    const auto deviation      = [ ] (const accumulator<type>& statistics)
+    {
+      const auto n = static_cast<type>(statistics.count());
+      return std::sqrt(statistics.variance() * n / (n - type(1)));
+    };
+    const auto real           = reported_statistics();
+    const auto real_mean      = real.mean();
+    const auto real_deviation = deviation(real);
+    auto       cpu_mean       = real_mean, cpu_median = median(), cpu_deviation = real_deviation;
+    if (&cpu_values != &values)
+    {
+      accumulator<type> cpu_statistics;
+      for (auto& value : cpu_values)
+        cpu_statistics.add(value);
+      auto cpu_order = cpu_values;
+      cpu_mean      = cpu_statistics.mean();
+      cpu_median    = select_percentile(cpu_order, type(50));
+      cpu_deviation = deviation(cpu_statistics);
+    }
+
+    entry("_mean"  , 0, "mean"  , "time"      , count, real_mean      * scale, cpu_mean      * scale);
+    writer << ",\n";
+    entry("_median", 0, "median", "time"      , count, median()       * scale, cpu_median    * scale);
+    writer << ",\n";
+    entry("_stddev", 0, "stddev", "time"      , count, real_deviation * scale, cpu_deviation * scale);
+    writer << ",\n";
+    entry("_cv"    , 0, "cv"    , "percentage", count, real_deviation / real_mean, cpu_deviation / cpu_mean);
+  }
+  // Reads the first record of a csv written by to_csv (see parse_csv).
+  static record         from_csv          (const std::string& filepath)
+  {
+    record result;
+    auto   found = false;
+    parse_csv(filepath, [&] (std::int64_t, record&& record)
+    {
+      if (!found)
+        result = std::move(record);
+      found = true;
+    });
+    return result;
+  }
+  // Invokes callback(rank, record) for each row of a csv written by to_csv, session::to_csv or mpi_session::to_csv. The rank is -1 in
+  // the absence of a rank column. The samples are recovered from the run columns and the statistics are recomputed from them, other
+  // columns are ignored. The file is read at once and parsed in place, hence only the names and samples of the records are allocated.
+  template <typename callback_type>
+  static void           parse_csv         (const std::string& filepath, callback_type&& callback)
+  {
+    std::ifstream stream(filepath, std::ios::binary | std::ios::ate);
+    if (!stream)
+      return;
+    std::string data(static_cast<std::size_t>(stream.tellg()), '\0');
+    stream.seekg(0);
+    stream.read (data.data(), static_cast<std::streamsize>(data.size()));
+
+    auto       position  = data.data();
+    const auto end       = data.data() + data.size();
+    // Returns the cell at the position and whether it ends the line, and advances past it. Quoted cells (RFC 4180) are unquoted in
+    // place, which never grows them.
+    const auto next_cell = [&] ()
+    {
+      std::string_view cell;
+      if (position != end && *position == '"')
+      {
+        const auto begin  = ++position;
+        auto       output = position;
+        for (; position != end && (*position != '"' || (position + 1 != end && position[1] == '"')); ++position)
+        {
+          if (*position == '"')
+            ++position;
+          *output++ = *position;
+        }
+        cell = std::string_view(begin, static_cast<std::size_t>(output - begin));
+        while (position != end && *position != ',' && *position != '\n')
+          ++position;
+      }
+      else
+      {
+        const auto begin = position;
+        while (position != end && *position != ',' && *position != '\n')
+          ++position;
+        cell = std::string_view(begin, static_cast<std::size_t>(position - begin));
+        if (!cell.empty() && cell.back() == '\r')
+          cell.remove_suffix(1);
+      }
+      const auto last  = position == end || *position == '\n';
+      if (position != end)
+        ++position;
+      return std::make_pair(cell, last);
+    };
+    const auto to_value  = [ ] (const std::string_view cell)
+    {
+      type value {};
+#ifdef __cpp_lib_to_chars
+      std::from_chars(cell.data(), cell.data() + cell.size(), value);
+#else
+      value = static_cast<type>(std::strtod(std::string(cell).c_str(), nullptr));
+#endif
+      return value;
+    };
+
+    enum class column { other, rank, name, unit, value, thread_cpu_value, process_cpu_value, thread };
+    std::vector<column> columns;
+    std::size_t         runs = 0;
+    for (auto last = position == end; !last;)
+    {
+      const auto [cell, ends] = next_cell();
+      last = ends;
+      const auto starts_with = [&cell = cell] (const std::string_view prefix) { return cell.substr(0, prefix.size()) == prefix; };
+      columns.push_back(
+        cell == "rank"                      ? column::rank              :
+        cell == "name"                      ? column::name              :
+        cell == "unit"                      ? column::unit              :
+        starts_with("run_"            )     ? column::value             :
+        starts_with("thread_cpu_run_" )     ? column::thread_cpu_value  :
+        starts_with("process_cpu_run_")     ? column::process_cpu_value :
+        starts_with("thread_run_"     )     ? column::thread            : column::other);
+      runs += columns.back() == column::value;
+    }
+
+    // Reused across rows.
+    std::vector<type>          values, thread_cpu_values, process_cpu_values;
+    std::vector<std::uint32_t> threads;
+    values.reserve(runs);
+    while (position != end)
+    {
+      record        record;
+      std::int64_t  rank = -1;
+      values            .clear();
+      thread_cpu_values .clear();
+      process_cpu_values.clear();
+      threads           .clear();
+
+      auto empty = true, last = false;
+      for (std::size_t i = 0; !last; ++i)
+      {
+        const auto [cell, ends] = next_cell();
+        last   = ends;
+        empty &= cell.empty();
+        if (i >= columns.size() || cell.empty())
+          continue;
+        switch (columns[i])
+        {
+        case column::rank             : std::from_chars(cell.data(), cell.data() + cell.size(), rank); break;
+        case column::name             : record.name = std::string(cell); break;
+        case column::unit             : record.unit = std::string(cell); break;
+        case column::value            : values            .push_back(to_value(cell)); break;
+        case column::thread_cpu_value : thread_cpu_values .push_back(to_value(cell)); break;
+        case column::process_cpu_value: process_cpu_values.push_back(to_value(cell)); break;
+        case column::thread           : std::from_chars(cell.data(), cell.data() + cell.size(), threads.emplace_back()); break;
+        default                       : break;
+        }
+      }
+      if (empty)
+        continue;
+
+      // Replayed through add, so that the running statistics are restored.
+      record.values.reserve(values.size());
+      if (!thread_cpu_values .empty())
+        record.thread_cpu_values .reserve(values.size());
+      if (!process_cpu_values.empty())
+        record.process_cpu_values.reserve(values.size());
+      if (!threads           .empty())
+        record.threads           .reserve(values.size());
+      for (std::size_t i = 0; i < values.size(); ++i)
+      {
+        bm::sample<type> sample;
+        sample.wall = values[i];
+        if (i < thread_cpu_values .size())
+          sample.thread_cpu  = thread_cpu_values [i];
+        if (i < process_cpu_values.size())
+          sample.process_cpu = process_cpu_values[i];
+        if (i < threads           .size())
+          sample.thread      = threads           [i];
+        record.add(sample);
+      }
+      record.iterations = record.values.size();
+      callback(rank, std::move(record));
+    }
+  }
+
+  std::string                name                ;
+  std::vector<type>          values              ;
+  std::size_t                batch_size          = 1;
+  type                       clock_overhead      = type(0);
+  type                       clock_jitter        = type(0);
+  std::vector<type>          thread_cpu_values   ;
+  std::vector<type>          process_cpu_values  ;
+  std::vector<std::uint32_t> threads             ; // Index (see thread_index) of the recording thread of each value, if recorded by a session_recorder.
+  accumulator<type>          statistics          ;
+  bm::storage                storage             = bm::storage::values;
+  bm::histogram<type>        histogram           ;
+  std::size_t                reservoir_size      = 0;
+  std::size_t                iterations          = 0;
+  std::size_t                bootstrap_resamples = 0;
+  outlier_method             exclude_outliers    = outlier_method::none;
+  std::string                unit                ;
+  std::string                clock               ;
+  // Index of the enclosing record within the session for nested sections, which are named by their path, e.g. "outer/inner".
+  // The exclusive statistics cover the time not spent in nested sections.
+  std::optional<std::size_t> parent              ;
+  accumulator<type>          exclusive_statistics;
+
+protected:
+  template <typename>
+  friend struct session;
+
+  template <typename value_type>
+  static void           place             (std::vector<value_type>& target, const std::size_t slot, const value_type value)
+  {
+    if      (slot == target.size())
+      target.push_back(value);
+    else if (slot <  target.size())
+      target[slot] = value;
+  }
+  // Number of samples each retained value stands for.
+  std::uint64_t         weight            () const
+  {
+    if (storage != bm::storage::reservoir || values.empty())
+      return 1;
+    return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::llround(static_cast<double>(current_statistics().count()) / static_cast<double>(values.size()))));
+  }
+  // Weighted random sampling without replacement (Efraimidis and Spirakis) of reservoir_size values from the union of both reservoirs,
+  // each value weighted by the number of samples it stands for.
+  void                  resample          (const record& that, const std::size_t that_count)
+  {
+    struct candidate
+    {
+      double        key   ;
+      const record* source;
+      std::size_t   index ;
+    };
+
+    const auto this_count = current_statistics().count();
+    std::uniform_real_distribution<double> distribution(std::numeric_limits<double>::min(), 1.0);
+    std::vector<candidate> candidates;
+    candidates.reserve(values.size() + that.values.size());
+    for (const auto& [source, count] : {std::make_pair(static_cast<const record*>(this), this_count), std::make_pair(&that, that_count)})
+      for (std::size_t i = 0; i < source->values.size(); ++i)
+        candidates.push_back({std::log(distribution(random_)) * static_cast<double>(source->values.size()) / static_cast<double>(count), source, i});
+
+    if (candidates.size() > reservoir_size)
+    {
+      std::nth_element(candidates.begin(), candidates.begin() + reservoir_size, candidates.end(), [] (const candidate& lhs, const candidate& rhs) { return lhs.key > rhs.key; });
+      candidates.resize(reservoir_size);
+    }
+
+    const auto aligned = [] (const auto& column, const record& source) { return column.size() == source.values.size(); };
+    const auto thread  = !thread_cpu_values .empty() && aligned(thread_cpu_values , *this) && aligned(that.thread_cpu_values , that);
+    const auto process = !process_cpu_values.empty() && aligned(process_cpu_values, *this) && aligned(that.process_cpu_values, that);
+    const auto tagged  = !threads           .empty() && aligned(threads           , *this) && aligned(that.threads           , that);
+    std::vector<type>          merged_values, merged_thread_cpu_values, merged_process_cpu_values;
+    std::vector<std::uint32_t> merged_threads;
+    for (auto& candidate : candidates)
+    {
+      merged_values.push_back(candidate.source->values[candidate.index]);
+      if (thread)
+        merged_thread_cpu_values .push_back(candidate.source->thread_cpu_values [candidate.index]);
+      if (process)
+        merged_process_cpu_values.push_back(candidate.source->process_cpu_values[candidate.index]);
+      if (tagged)
+        merged_threads           .push_back(candidate.source->threads           [candidate.index]);
+    }
+    values             = std::move(merged_values);
+    thread_cpu_values  = std::move(merged_thread_cpu_values );
+    process_cpu_values = std::move(merged_process_cpu_values);
+    threads            = std::move(merged_threads           );
+  }
+
+  // The running statistics are used unless the values were modified without add, in which case they are recomputed in a single pass.
+  constexpr accumulator<type> current_statistics() const
+  {
+    if (storage != bm::storage::values || statistics.count() == values.size())
+      return statistics;
+    accumulator<type> result;
+    for (auto& value : values)
+      result.add(value);
+    return result;
+  }
+
+  // Severe lower, mild lower, mild upper and severe upper fence.
+  std::array<type, 4>   fences            (const outlier_method method) const
+  {
+    if (method == outlier_method::tukey)
+    {
+      const auto first = percentile(type(25)), third = percentile(type(75)), range = third - first;
+      return {first - type(3) * range, first - type(1.5) * range, third + type(1.5) * range, third + type(3) * range};
+    }
+    // The median absolute deviation is scaled to estimate the standard deviation of normally distributed values.
+    const auto center = median(), deviation = type(1.4826) * median_absolute_deviation();
+    return {center - type(5) * deviation, center - type(3) * deviation, center + type(3) * deviation, center + type(5) * deviation};
+  }
+  // The current statistics, excluding the outliers if requested. The latter are recomputed once per change in the samples.
+  accumulator<type>     reported_statistics() const
+  {
+    if (exclude_outliers == outlier_method::none || storage == bm::storage::histogram || values.empty())
+      return current_statistics();
+
+    return filtered_.get({values.size(), statistics.count()}, [this]
+    {
+      const auto        bounds = fences(exclude_outliers);
+      accumulator<type> result;
+      for (auto& value : values)
+        if (value >= bounds[1] && value <= bounds[2])
+          result.add(value);
+      return result;
+    });
+  }
+
+  sorted_cache<type>                          sorted_      ;
+  filtered_cache<type>                        filtered_    ;
+  std::minstd_rand                            random_      ;
+};
+
+static_assert(std::is_nothrow_move_constructible_v<record<double>>, "Records are expected to move rather than copy when their containers grow.");
+
+// Number of iterations to reserve storage for. Runs which may stop early reserve a bounded amount and grow past it on demand.
+inline std::size_t reserved_iterations(const options& options, const std::size_t iterations)
+{
+  if (options.time_budget.count() > 0 || options.target_relative_standard_error > 0.0 || options.target_confidence_interval > 0.0)
+    return std::min<std::size_t>(iterations, 4096);
+  return iterations;
+}
+
+// Creates a record configured for the given options, with storage reserved for the given number of iterations.
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+record<type>      make_record(const std::string& name, const options& options, const std::size_t iterations)
+{
+  record<type> record {name};
+  record.unit  = unit_symbol<period>();
+  record.clock = clock_name <clock >();
+  record.storage = options.storage;
+  if (options.storage == storage::histogram)
+    record.histogram = histogram<type>(static_cast<type>(options.histogram_lowest), static_cast<type>(options.histogram_highest), options.histogram_significant_digits);
+
+  const auto reserved = options.storage == storage::histogram ? 0 : options.storage == storage::reservoir ? std::min(reserved_iterations(options, iterations), options.reservoir_size) : reserved_iterations(options, iterations);
+  record.reservoir_size      = options.reservoir_size;
+  record.bootstrap_resamples = options.bootstrap_resamples;
+  record.exclude_outliers    = options.exclude_outliers;
+  record.values.reserve(reserved);
+  if (options.capture_thread_cpu_time)
+    record.thread_cpu_values .reserve(reserved);
+  if (options.capture_process_cpu_time)
+    record.process_cpu_values.reserve(reserved);
+  return record;
+}
+
+// Comparison of a contender record to a baseline record.
+template <typename type = double>
+struct comparison
+{
+  // Whether the difference is significant at the given level, by the Welch t-test and, if the values are available, the Mann-Whitney U test.
+  constexpr bool significant(const double alpha = 0.05) const
+  {
+    return welch_p < alpha && (std::isnan(mann_whitney_p) || mann_whitney_p < alpha);
+  }
+  constexpr bool faster     (const double alpha = 0.05) const
+  {
+    return significant(alpha) && speedup > type(1);
+  }
+  constexpr bool slower     (const double alpha = 0.05) const
+  {
+    return significant(alpha) && speedup < type(1);
+  }
+
+  // Mean of the baseline divided by the mean of the contender, hence greater than one if the contender is faster.
+  type           speedup                  = std::numeric_limits<type>::quiet_NaN();
+  interval<type> speedup_interval         {std::numeric_limits<type>::quiet_NaN(), std::numeric_limits<type>::quiet_NaN()};
+  double         welch_t                  = std::numeric_limits<double>::quiet_NaN();
+  double         welch_degrees_of_freedom = std::numeric_limits<double>::quiet_NaN();
+  double         welch_p                  = std::numeric_limits<double>::quiet_NaN();
+  double         mann_whitney_u           = std::numeric_limits<double>::quiet_NaN();
+  double         mann_whitney_p           = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Compares the contender to the baseline. The confidence interval of the speedup is obtained from the standard errors of the log means
+// (delta method) and the Welch degrees of freedom. The Mann-Whitney U test uses the normal approximation with tie correction, and
+// requires the values of both records.
+template <typename type = double>
+comparison<type>  compare    (const record<type>& baseline, const record<type>& contender, const type level = type(0.95))
+{
+  comparison<type> result;
+  const auto n1 = static_cast<double>(baseline.count()), n2 = static_cast<double>(contender.count());
+  if (n1 < 2 || n2 < 2)
+    return result;
+
+  const auto m1 = static_cast<double>(baseline.mean()), m2 = static_cast<double>(contender.mean());
+  const auto e1 = static_cast<double>(baseline.variance()) / (n1 - 1.0); // Squared standard errors, from the sample variances.
+  const auto e2 = static_cast<double>(contender.variance()) / (n2 - 1.0);
+
+  result.welch_t                  = (m1 - m2) / std::sqrt(e1 + e2);
+  result.welch_degrees_of_freedom = (e1 + e2) * (e1 + e2) / (e1 * e1 / (n1 - 1.0) + e2 * e2 / (n2 - 1.0));
+  result.welch_p                  = e1 + e2 > 0.0 ? 2.0 * (1.0 - student_t_cdf(std::abs(result.welch_t), result.welch_degrees_of_freedom)) : (m1 == m2 ? 1.0 : 0.0);
+
+  result.speedup = static_cast<type>(m1 / m2);
+  if (m1 > 0.0 && m2 > 0.0)
+  {
+    const auto error = std::sqrt(e1 / (m1 * m1) + e2 / (m2 * m2)) * (e1 + e2 > 0.0 ? student_t_quantile(0.5 + static_cast<double>(level) / 2.0, result.welch_degrees_of_freedom) : 0.0);
+    result.speedup_interval = {static_cast<type>(m1 / m2 * std::exp(-error)), static_cast<type>(m1 / m2 * std::exp(error))};
+  }
+
+  const auto& a = baseline.values, & b = contender.values;
+  if (a.empty() || b.empty())
+    return result;
+
+  std::vector<std::pair<type, bool>> combined;
+  combined.reserve(a.size() + b.size());
+  for (auto& value : a)
+    combined.emplace_back(value, true );
+  for (auto& value : b)
+    combined.emplace_back(value, false);
+  std::sort(combined.begin(), combined.end(), [] (const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+  // Tied values share the average of their ranks.
+  double rank_sum = 0.0, ties = 0.0;
+  for (std::size_t i = 0; i < combined.size();)
+  {
+    auto j = i;
+    while (j < combined.size() && combined[j].first == combined[i].first)
+      ++j;
+    const auto rank  = static_cast<double>(i + j + 1) / 2.0;
+    const auto tied  = static_cast<double>(j - i);
+    ties += tied * tied * tied - tied;
+    for (auto k = i; k < j; ++k)
+      if (combined[k].second)
+        rank_sum += rank;
+    i = j;
+  }
+
+  const auto s1 = static_cast<double>(a.size()), s2 = static_cast<double>(b.size()), total = s1 + s2;
+  result.mann_whitney_u = rank_sum - s1 * (s1 + 1.0) / 2.0;
+  const auto deviation  = std::sqrt(s1 * s2 / 12.0 * ((total + 1.0) - ties / (total * (total - 1.0))));
+  const auto difference = std::abs(result.mann_whitney_u - s1 * s2 / 2.0);
+  result.mann_whitney_p = deviation > 0.0 ? std::min(1.0, 2.0 * (1.0 - normal_cdf(std::max(0.0, difference - 0.5) / deviation))) : 1.0;
+  return result;
+}
+
+// Lightweight identifier of a record within a session, obtained once by name and valid for the lifetime of the session.
+struct handle
+{
+  std::size_t index;
+};
+
+enum class binary_compression
+{
+  none     , // Read without copying.
+  xor_delta  // Each value XORed with its predecessor and stored without its leading zero bytes. Decoded on load.
+};
+
+// Leading block of the binary format written by session::to_binary, followed by the sample columns of each record (aligned to 64
+// bytes) and a directory locating them. Values are stored in native byte order, which is verified on load through byte_order.
+struct binary_header
+{
+  char          magic[4]         = {'B', 'M', 'R', 'S'};
+  std::uint32_t version          = 2;
+  std::uint32_t byte_order       = 0x01020304;
+  std::uint32_t value_size       = 0;
+  std::uint32_t compression      = 0;
+  std::uint32_t reserved         = 0;
+  std::uint64_t record_count     = 0;
+  std::uint64_t directory_offset = 0;
+  double        clock_overhead   = 0.0;
+  double        clock_jitter     = 0.0;
+  std::uint64_t iterations       = 0;
+};
+static_assert(sizeof(binary_header) == 64, "The binary header is expected to be unpadded.");
+
+struct binary_column
+{
+  std::uint64_t offset = 0;
+  std::uint64_t count  = 0;
+  std::uint64_t bytes  = 0;
+};
+// Running statistics of a record (see accumulator), which a histogram does not retain.
+struct binary_statistics
+{
+  std::uint64_t count    = 0;
+  double        mean     = 0.0;
+  double        variance = 0.0;
+  double        min      = 0.0;
+  double        max      = 0.0;
+};
+
+// Number of significant bytes of each XOR in a nibble (two per byte, preceding the payload), followed by the significant bytes.
+template <typename type>
+void              encode_xor_delta(const std::vector<type>& values, std::string& data)
+{
+  using bits_type = std::conditional_t<sizeof(type) == 4, std::uint32_t, std::uint64_t>;
+  static_assert(sizeof(type) == sizeof(bits_type), "Compression requires 32 or 64 bit values.");
+
+  data.assign((values.size() + 1) / 2, '\0');
+  bits_type previous = 0;
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    bits_type bits;
+    std::memcpy(&bits, &values[i], sizeof(type));
+    auto delta = bits ^ previous;
+    previous   = bits;
+
+    std::uint8_t length = 0;
+    for (auto remaining = delta; remaining != 0; remaining >>= 8)
+      ++length;
+    data[i / 2] = static_cast<char>(static_cast<std::uint8_t>(data[i / 2]) | (length << (4 * (i % 2))));
+    for (std::uint8_t j = 0; j < length; ++j, delta >>= 8)
+      data.push_back(static_cast<char>(delta & 0xFF));
+  }
+}
+template <typename type>
+bool              decode_xor_delta(const char* data, const std::size_t bytes, std::vector<type>& values)
+{
+  using bits_type = std::conditional_t<sizeof(type) == 4, std::uint32_t, std::uint64_t>;
+
+  const auto lengths  = (values.size() + 1) / 2;
+  auto       position = lengths;
+  bits_type  previous = 0;
+  if (lengths > bytes)
+    return false;
+  for (std::size_t i = 0; i < values.size(); ++i)
+  {
+    const auto length = static_cast<std::size_t>((static_cast<std::uint8_t>(data[i / 2]) >> (4 * (i % 2))) & 0x0F);
+    if (length > sizeof(type) || position + length > bytes)
+      return false;
+    bits_type delta = 0;
+    for (std::size_t j = 0; j < length; ++j)
+      delta |= static_cast<bits_type>(static_cast<std::uint8_t>(data[position + j])) << (8 * j);
+    position += length;
+    previous ^= delta;
+    std::memcpy(&values[i], &previous, sizeof(type));
+  }
+  return true;
+}
+
+// Read only view of a file, memory mapped where supported and read at once otherwise.
+class  mapped_file
+{
+public:
+  explicit mapped_file  (const std::string& filepath)
+  {
+#if defined(BM_MMAP_SUPPORT) && defined(_WIN32)
+    file_ = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+      return;
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ && (data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0))))
+      size_ = static_cast<std::size_t>(size.QuadPart);
+#elif defined(BM_MMAP_SUPPORT)
+    const auto descriptor = open(filepath.c_str(), O_RDONLY);
+    if (descriptor < 0)
+      return;
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && status.st_size > 0)
+    {
+      const auto address = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (address != MAP_FAILED)
+      {
+        data_ = static_cast<const char*>(address);
+        size_ = static_cast<std::size_t>(status.st_size);
+      }
+    }
+    close(descriptor);
+#else
+    std::ifstream stream(filepath, std::ios::binary | std::ios::ate);
+    if (!stream)
+      return;
+    buffer_.resize(static_cast<std::size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read (buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+  }
+  mapped_file           (const mapped_file&  that) = delete;
+  mapped_file           (      mapped_file&& temp) noexcept
+  {
+    *this = std::move(temp);
+  }
+ ~mapped_file           ()
+  {
+    release();
+  }
+  mapped_file& operator=(const mapped_file&  that) = delete;
+  mapped_file& operator=(      mapped_file&& temp) noexcept
+  {
+    if (this != &temp)
+    {
+      release();
+      data_    = std::exchange(temp.data_, nullptr);
+      size_    = std::exchange(temp.size_, 0);
+#if defined(BM_MMAP_SUPPORT) && defined(_WIN32)
+      file_    = std::exchange(temp.file_   , INVALID_HANDLE_VALUE);
+      mapping_ = std::exchange(temp.mapping_, nullptr);
+#elif !defined(BM_MMAP_SUPPORT)
+      buffer_  = std::move(temp.buffer_);
+#endif
+    }
+    return *this;
+  }
+
+  const char* data() const
+  {
+    return data_;
+  }
+  std::size_t size() const
+  {
+    return size_;
+  }
+
+protected:
+  void release()
+  {
+#if defined(BM_MMAP_SUPPORT) && defined(_WIN32)
+    if (data_)
+      UnmapViewOfFile(data_);
+    if (mapping_)
+      CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+      CloseHandle(file_);
+    file_    = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+#elif defined(BM_MMAP_SUPPORT)
+    if (data_)
+      munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char*       data_    = nullptr;
+  std::size_t       size_    = 0;
+#if defined(BM_MMAP_SUPPORT) && defined(_WIN32)
+  HANDLE            file_    = INVALID_HANDLE_VALUE;
+  HANDLE            mapping_ = nullptr;
+#elif !defined(BM_MMAP_SUPPORT)
+  std::vector<char> buffer_  ;
+#endif
+};
+
+// Contiguous read only sequence, e.g. a sample column within a mapped file.
+template <typename type>
+struct span
+{
+  constexpr const type*  begin     () const
+  {
+    return data;
+  }
+  constexpr const type*  end       () const
+  {
+    return data + size;
+  }
+  constexpr bool         empty     () const
+  {
+    return size == 0;
+  }
+  constexpr const type&  operator[](const std::size_t index) const
+  {
+    return data[index];
+  }
+
+  const type* data = nullptr;
+  std::size_t size = 0;
+};
+
+// Occurrence of a recorded section, in the unit of its record and relative to the timeline origin.
+template <typename type = double>
+struct timeline_event
+{
+  std::size_t   record   ; // Index in session::records.
+  std::size_t   iteration;
+  std::uint32_t thread   ;
+  type          start    ;
+  type          end      ;
+};
+
+template <typename type = double>
+struct session
+{
+  virtual ~session() = default;
+
+  // Returns the index of the first record with the given name, or records.size() if there is none.
+  std::size_t         find     (const std::string& name) const
+  {
+    return lookup_.find(records, name);
+  }
+  // Returns the index of the record named by the path prefix of the given name (e.g. "outer" for "outer/inner"), if there is one.
+  std::optional<std::size_t> find_parent(const std::string& name) const
+  {
+    const auto separator = name.rfind('/');
+    if (separator == std::string::npos)
+      return std::nullopt;
+    const auto index = find(name.substr(0, separator));
+    if (index == records.size())
+      return std::nullopt;
+    return index;
+  }
+  void                reserve  (const std::size_t count)
+  {
+    records.reserve(count);
+    lookup_.reserve(count);
+  }
+  std::size_t         insert   (bm::record<type> record)
+  {
+    records.push_back(std::move(record));
+    lookup_.insert(records.back().name, records.size() - 1);
+    return records.size() - 1;
+  }
+
+  // Smallest layout holding the samples of every record.
+  csv_layout          layout   () const
+  {
+    csv_layout result;
+    for (auto& record : records)
+    {
+      result.values             = std::max(result.values            , record.values            .size());
+      result.thread_cpu_values  = std::max(result.thread_cpu_values , record.thread_cpu_values .size());
+      result.process_cpu_values = std::max(result.process_cpu_values, record.process_cpu_values.size());
+      result.threads            = std::max(result.threads           , record.threads           .size());
+    }
+    return result;
+  }
+
+  virtual std::string to_string() const
+  {
+    std::ostringstream stream;
+    {
+      buffered_writer writer(stream);
+      write_rows(writer);
+    }
+    return stream.str();
+  }
+  // Streams the records to the file through a fixed buffer, hence the csv is never held in memory as a whole.
+  virtual void        to_csv   (const std::string& filepath) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    record<type>::write_header(writer, layout());
+    writer << '\n';
+    write_rows(writer);
+  }
+
+  // Writes a json in the schema of Google Benchmark, with a family per record (see record::write_json).
+  virtual void        to_json  (const std::string& filepath, const bool aggregates_only = false) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "{\n";
+    system_context::query().write_json(writer);
+    writer << ",\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+      if (i > 0)
+        writer << ",\n";
+      records[i].write_json(writer, records[i].name, i, 0, aggregates_only);
+    }
+    writer << "\n  ]\n}\n";
+  }
+
+  // Writes the records in the binary columnar format read by mapped_session (see binary_header). The columns are streamed to the file
+  // and the directory is appended once their locations are known.
+  void                to_binary(const std::string& filepath, const binary_compression compression = binary_compression::none) const
+  {
+    constexpr std::size_t alignment = 64;
+    std::ofstream stream(filepath, std::ios::binary);
+    const auto align = [&] ()
+    {
+      static constexpr char padding[alignment] = {};
+      const auto position = static_cast<std::size_t>(stream.tellp());
+      stream.write(padding, static_cast<std::streamsize>((alignment - position % alignment) % alignment));
+      return static_cast<std::uint64_t>(position + (alignment - position % alignment) % alignment);
+    };
+    const auto append = [&] (const auto& value)
+    {
+      stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    const auto append_string = [&] (const std::string& text)
+    {
+      append(static_cast<std::uint32_t>(text.size()));
+      stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+    };
+
+    binary_header header;
+    header.value_size     = sizeof(type);
+    header.compression    = static_cast<std::uint32_t>(sizeof(type) == 4 || sizeof(type) == 8 ? compression : binary_compression::none);
+    header.record_count   = records.size();
+    header.clock_overhead = static_cast<double>(clock_overhead);
+    header.clock_jitter   = static_cast<double>(clock_jitter);
+    header.iterations     = iterations;
+    append(header);
+
+    std::string encoded;
+    const auto write_column = [&] (const std::vector<type>& values)
+    {
+      binary_column column {align(), values.size(), values.size() * sizeof(type)};
+      if constexpr (sizeof(type) == 4 || sizeof(type) == 8)
+        if (header.compression == static_cast<std::uint32_t>(binary_compression::xor_delta))
+        {
+          encode_xor_delta(values, encoded);
+          column.bytes = encoded.size();
+          stream.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+          return column;
+        }
+      stream.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(column.bytes));
+      return column;
+    };
+
+    std::vector<std::array<binary_column, 5>> columns;
+    columns.reserve(records.size());
+    for (auto& record : records)
+    {
+      const auto serialized = record.storage == bm::storage::histogram ? record.histogram.serialize() : std::string();
+      const auto values     = write_column(record.values            );
+      const auto thread     = write_column(record.thread_cpu_values );
+      const auto process    = write_column(record.process_cpu_values);
+      const binary_column histogram {align(), 0, serialized.size()};
+      stream.write(serialized.data(), static_cast<std::streamsize>(serialized.size()));
+      // The thread indices are small integers, hence stored uncompressed.
+      const binary_column threads {align(), record.threads.size(), record.threads.size() * sizeof(std::uint32_t)};
+      stream.write(reinterpret_cast<const char*>(record.threads.data()), static_cast<std::streamsize>(threads.bytes));
+      columns.push_back({values, thread, process, histogram, threads});
+    }
+
+    header.directory_offset = align();
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+      auto& record = records[i];
+      append_string(record.name );
+      append_string(record.unit );
+      append_string(record.clock);
+      append(static_cast<std::uint64_t>(record.storage       ));
+      append(static_cast<std::uint64_t>(record.batch_size    ));
+      append(static_cast<std::uint64_t>(record.iterations    ));
+      append(static_cast<std::uint64_t>(record.reservoir_size));
+      append(static_cast<double>       (record.clock_overhead));
+      append(static_cast<double>       (record.clock_jitter  ));
+      append(columns[i]);
+      const auto statistics = record.current_statistics();
+      binary_statistics serialized;
+      serialized.count = statistics.count();
+      if (statistics.count() > 0)
+      {
+        serialized.mean     = static_cast<double>(statistics.mean    ());
+        serialized.variance = static_cast<double>(statistics.variance());
+        serialized.min      = static_cast<double>(statistics.min     ());
+        serialized.max      = static_cast<double>(statistics.max     ());
+      }
+      append(serialized);
+    }
+
+    stream.seekp(0);
+    append(header);
+  }
+
+  // Reads a csv written by to_csv (see record::parse_csv). The rank column of a csv written by mpi_session::to_csv is ignored.
+  static session      from_csv (const std::string& filepath)
+  {
+    session result;
+    record<type>::parse_csv(filepath, [&] (std::int64_t, record<type>&& record)
+    {
+      result.iterations = std::max(result.iterations, record.iterations);
+      result.insert(std::move(record));
+    });
+    return result;
+  }
+
+  // Writes the timeline as Chrome trace-event json (complete events in microseconds), which loads in Perfetto and chrome://tracing.
+  virtual void        to_trace (const std::string& filepath) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "{\"traceEvents\":[\n";
+    write_trace_events(writer, 0, true);
+    writer << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  }
+
+  // Writes the records in depth first order of their nesting (see session_recorder::handle), with their depth, number of calls and
+  // inclusive and exclusive mean and total time.
+  void                to_hierarchical_csv(const std::string& filepath) const
+  {
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "path,name,depth,calls,inclusive mean,inclusive total,exclusive mean,exclusive total\n";
+    traverse([&] (const std::size_t index, const std::size_t depth)
+    {
+      const auto& record    = records[index];
+      const auto  inclusive = record.current_statistics();
+      const auto  exclusive = record.exclusive_statistics.count() > 0 ? record.exclusive_statistics : inclusive;
+      write_csv_field(writer, record.name);
+      writer << ',';
+      write_csv_field(writer, leaf(index));
+      writer << ',' << depth << ',' << inclusive.count() << ',';
+      writer << inclusive.mean() << ',' << inclusive.mean() * static_cast<type>(inclusive.count()) << ',';
+      writer << exclusive.mean() << ',' << exclusive.mean() * static_cast<type>(exclusive.count()) << '\n';
+    });
+  }
+  // Writes the exclusive total time of each record in nanoseconds as folded stacks (e.g. "outer;inner 1234"), as read by flame graph
+  // tools such as flamegraph.pl, speedscope and Perfetto.
+  void                to_folded(const std::string& filepath) const
+  {
+    std::ofstream            stream(filepath, std::ios::binary);
+    buffered_writer          writer(stream);
+    std::vector<std::string> stacks(records.size());
+    traverse([&] (const std::size_t index, std::size_t)
+    {
+      const auto& record = records[index];
+      auto        frame  = std::string(leaf(index));
+      std::replace(frame.begin(), frame.end(), ';', '_');
+      stacks[index] = record.parent && *record.parent < records.size() ? stacks[*record.parent] + ";" + frame : frame;
+
+      const auto exclusive = record.exclusive_statistics.count() > 0 ? record.exclusive_statistics : record.current_statistics();
+      const auto weight    = std::llround(static_cast<double>(exclusive.mean()) * static_cast<double>(exclusive.count()) * seconds_per_unit(record.unit) * 1e9);
+      if (weight > 0)
+        writer << stacks[index] << ' ' << weight << '\n';
+    });
+  }
+
+  std::vector<record<type>>         records;
+  type                              clock_overhead = type(0);
+  type                              clock_jitter   = type(0);
+  std::size_t                       iterations     = 0;
+  std::vector<timeline_event<type>> timeline;
+
+protected:
+  // Visits the records depth first, each before the records nested in it, as function(index, depth).
+  template <typename function_type>
+  void                traverse (function_type&& function) const
+  {
+    std::vector<std::vector<std::size_t>> children(records.size());
+    std::vector<std::pair<std::size_t, std::size_t>> stack;
+    for (auto i = records.size(); i-- > 0;)
+    {
+      if (records[i].parent && *records[i].parent < records.size())
+        children[*records[i].parent].push_back(i);
+      else
+        stack.emplace_back(i, 0);
+    }
+    while (!stack.empty())
+    {
+      const auto [index, depth] = stack.back();
+      stack.pop_back();
+      function(index, depth);
+      for (auto child : children[index])
+        stack.emplace_back(child, depth + 1);
+    }
+  }
+  // Name of the record without the path of the enclosing record.
+  std::string_view    leaf     (const std::size_t index) const
+  {
+    const std::string_view name = records[index].name;
+    const auto&            parent = records[index].parent;
+    if (!parent || *parent >= records.size())
+      return name;
+    const std::string_view prefix = records[*parent].name;
+    return name.size() > prefix.size() && name.substr(0, prefix.size()) == prefix && name[prefix.size()] == '/' ? name.substr(prefix.size() + 1) : name;
+  }
+  void                write_trace_events(buffered_writer& writer, const std::int32_t process, bool first) const
+  {
+    for (auto& event : timeline)
+    {
+      if (event.record >= records.size())
+        continue;
+      const auto& record       = records[event.record];
+      const auto  microseconds = seconds_per_unit(record.unit) * 1e6;
+      writer << (first ? "" : ",\n") << "{\"name\":";
+      write_json_string(writer, leaf(event.record));
+      writer << ",\"cat\":\"bm\",\"ph\":\"X\",\"ts\":"  << static_cast<double>(event.start) * microseconds;
+      writer << ",\"dur\":" << static_cast<double>(event.end - event.start) * microseconds;
+      writer << ",\"pid\":" << process << ",\"tid\":" << event.thread << ",\"args\":{\"iteration\":" << event.iteration << "}}";
+      first = false;
+    }
+  }
+  void                write_rows(buffered_writer& writer) const
+  {
+    const auto columns = layout();
+    for (auto& record : records)
+    {
+      record.write_row(writer, columns);
+      writer << '\n';
+    }
+  }
+
+  name_index lookup_; // The records are public, hence the index is rebuilt whenever it is found out of date (see name_index).
+};
+
+// Record within a mapped_session. The columns and strings point into the mapped file, or into decoded columns if it is compressed.
+template <typename type = double>
+struct record_view
+{
+  // Copies the view into a record, replaying the samples to restore its statistics.
+  bm::record<type> to_record() const
+  {
+    bm::record<type> result {std::string(name)};
+    result.unit           = std::string(unit );
+    result.clock          = std::string(clock);
+    result.batch_size     = batch_size;
+    result.clock_overhead = clock_overhead;
+    result.clock_jitter   = clock_jitter;
+    result.reservoir_size = reservoir_size;
+    result.iterations     = iterations;
+    result.storage        = storage == bm::storage::histogram ? bm::storage::histogram : bm::storage::values;
+    if (storage == bm::storage::histogram)
+    {
+      result.histogram  = bm::histogram<type>::deserialize(std::string(histogram));
+      result.statistics = statistics;
+      return result;
+    }
+
+    result.values.reserve(values.size);
+    for (std::size_t i = 0; i < values.size; ++i)
+    {
+      bm::sample<type> sample;
+      sample.wall = values[i];
+      if (i < thread_cpu_values .size)
+        sample.thread_cpu  = thread_cpu_values [i];
+      if (i < process_cpu_values.size)
+        sample.process_cpu = process_cpu_values[i];
+      if (i < threads           .size)
+        sample.thread      = threads           [i];
+      result.add(sample);
+    }
+    // A reservoir retains a subset of the samples the statistics cover.
+    if (statistics.count() > result.statistics.count())
+      result.statistics = statistics;
+    result.storage    = storage;
+    return result;
+  }
+
+  std::string_view name              ;
+  std::string_view unit              ;
+  std::string_view clock             ;
+  bm::storage      storage           = bm::storage::values;
+  std::size_t      batch_size        = 1;
+  std::size_t      iterations        = 0;
+  std::size_t      reservoir_size    = 0;
+  type             clock_overhead    = type(0);
+  type             clock_jitter      = type(0);
+  span<type>       values            ;
+  span<type>       thread_cpu_values ;
+  span<type>       process_cpu_values;
+  span<std::uint32_t> threads        ; // Index (see thread_index) of the recording thread of each value, if tagged.
+  std::string_view histogram         ; // Serialized (see histogram::serialize).
+  accumulator<type> statistics       ;
+};
+
+// Memory mapped reader of the binary format written by session::to_binary. Uncompressed columns are not copied. The views are
+// invalid, and valid() is false, if the file is missing, truncated, or was written with another format version, value type or byte order.
+template <typename type = double>
+class  mapped_session
+{
+public:
+  explicit mapped_session(const std::string& filepath) : file_(filepath), valid_(load())
+  {
+    if (!valid_)
+    {
+      records_.clear();
+      decoded_.clear();
+    }
+  }
+
+  bool                                  valid         () const
+  {
+    return valid_;
+  }
+  const std::vector<record_view<type>>& records       () const
   {
-    return std::accumulate(values.begin(), values.end(), type(0)) / static_cast<type>(values.size());
+    return records_;
   }
-  constexpr type        variance          () const
+  type                                  clock_overhead() const
   {
-    auto m = mean();
-    std::vector<type> differences(values.size());
-    std::transform(values.begin(), values.end(), differences.begin(), [m] (const type& value) { return value - m; });
-    return std::inner_product(differences.begin(), differences.end(), differences.begin(), type(0)) / static_cast<type>(values.size());
+    return clock_overhead_;
   }
-  constexpr type        standard_deviation() const
+  type                                  clock_jitter  () const
   {
-    return std::sqrt(variance());
+    return clock_jitter_;
   }
-                                                              
-  constexpr std::string to_string         () const
+  std::size_t                           iterations    () const
   {
-    std::ostringstream stream;
-    stream.precision(std::numeric_limits<type>::max_digits10);
-    stream << name << ",";
-    for (auto& value : values)
-      stream << value << ",";
-    stream << mean() << "," << variance() << "," << standard_deviation();
-    return stream.str();
+    return iterations_;
   }
-  constexpr void        to_csv            (const std::string& filepath) const
+  // Copies the views into a session.
+  session<type>                         to_session    () const
   {
-    std::ofstream stream(filepath);
-    stream << "name,";
-    for (std::size_t i = 0; i < values.size(); ++i)
-      stream << "run_" << i << ",";
-    stream << "mean,variance,standard deviation\n";
-    stream << to_string();
+    session<type> result;
+    result.reserve(records_.size());
+    for (auto& record : records_)
+      result.insert(record.to_record());
+    result.clock_overhead = clock_overhead_;
+    result.clock_jitter   = clock_jitter_;
+    result.iterations     = iterations_;
+    return result;
+  }
+
+protected:
+  bool load()
+  {
+    binary_header header;
+    const auto data = file_.data();
+    const auto size = file_.size();
+    if (size < sizeof(binary_header))
+      return false;
+    std::memcpy(&header, data, sizeof(binary_header));
+    if (std::memcmp(header.magic, binary_header().magic, 4) != 0 || header.version != binary_header().version || 
+        header.byte_order != binary_header().byte_order || header.value_size != sizeof(type) || header.directory_offset > size || 
+        header.compression > static_cast<std::uint32_t>(binary_compression::xor_delta))
+      return false;
+
+    auto offset = static_cast<std::size_t>(header.directory_offset);
+    const auto read        = [&] (auto& value)
+    {
+      if (offset + sizeof(value) > size)
+        return false;
+      std::memcpy(&value, data + offset, sizeof(value));
+      offset += sizeof(value);
+      return true;
+    };
+    const auto read_string = [&] (std::string_view& text)
+    {
+      std::uint32_t length = 0;
+      if (!read(length) || offset + length > size)
+        return false;
+      text    = std::string_view(data + offset, length);
+      offset += length;
+      return true;
+    };
+
+    // Each entry of the directory holds at least three string lengths and the fixed size fields.
+    const     std::size_t entry_size = 3 * sizeof(std::uint32_t) + 4 * sizeof(std::uint64_t) + 2 * sizeof(double) + 5 * sizeof(binary_column) + 
+                                   sizeof(binary_statistics);
+    if (header.record_count > (size - offset) / entry_size)
+      return false;
+    records_.resize(static_cast<std::size_t>(header.record_count));
+    for (auto& record : records_)
+    {
+      std::uint64_t storage, batch_size, iterations, reservoir_size;
+      double        clock_overhead, clock_jitter;
+      std::array<binary_column, 5> columns;
+      if (!read_string(record.name) || !read_string(record.unit) || !read_string(record.clock) || !read(storage) || !read(batch_size) || 
+          !read(iterations) || !read(reservoir_size) || !read(clock_overhead) || !read(clock_jitter) || !read(columns))
+        return false;
+      for (auto& column : columns)
+        if (column.bytes > size || column.offset > size - column.bytes)
+          return false;
+      binary_statistics statistics;
+      if (!read(statistics))
+        return false;
+      record.statistics     = accumulator<type>::restore(static_cast<std::size_t>(statistics.count), static_cast<type>(statistics.mean), 
+        static_cast<type>(statistics.variance), static_cast<type>(statistics.min), static_cast<type>(statistics.max));
+
+      if (storage > static_cast<std::uint64_t>(bm::storage::reservoir))
+        return false;
+      record.storage        = static_cast<bm::storage>(storage);
+      record.batch_size     = static_cast<std::size_t>(batch_size);
+      record.iterations     = static_cast<std::size_t>(iterations);
+      record.reservoir_size = static_cast<std::size_t>(reservoir_size);
+      record.clock_overhead = static_cast<type>(clock_overhead);
+      record.clock_jitter   = static_cast<type>(clock_jitter);
+      record.histogram      = std::string_view(data + columns[3].offset, static_cast<std::size_t>(columns[3].bytes));
+      if (record.storage == bm::storage::histogram && !histogram<type>::readable(record.histogram))
+        return false;
+      if (columns[4].bytes % sizeof(std::uint32_t) != 0 || columns[4].count != columns[4].bytes / sizeof(std::uint32_t) || 
+          reinterpret_cast<std::uintptr_t>(data + columns[4].offset) % alignof(std::uint32_t) != 0)
+        return false;
+      record.threads        = {reinterpret_cast<const std::uint32_t*>(data + columns[4].offset), static_cast<std::size_t>(columns[4].count)};
+      for (auto [target, column] : {std::make_pair(&record.values, columns[0]), std::make_pair(&record.thread_cpu_values, columns[1]), std::make_pair(&record.process_cpu_values, columns[2])})
+      {
+        const auto count = static_cast<std::size_t>(column.count);
+        if (header.compression == static_cast<std::uint32_t>(binary_compression::xor_delta))
+        {
+          if constexpr (sizeof(type) == 4 || sizeof(type) == 8)
+          {
+            if ((column.count + 1) / 2 > column.bytes)
+              return false;
+            auto& decoded = decoded_.emplace_back(count);
+            if (!decode_xor_delta(data + column.offset, static_cast<std::size_t>(column.bytes), decoded))
+              return false;
+            *target = {decoded.data(), count};
+          }
+        }
+        else
+        {
+          if (column.bytes % sizeof(type) != 0 || column.count != column.bytes / sizeof(type) || 
+              reinterpret_cast<std::uintptr_t>(data + column.offset) % alignof(type) != 0)
+            return false;
+          *target = {reinterpret_cast<const type*>(data + column.offset), count};
+        }
+      }
+    }
+
+    clock_overhead_ = static_cast<type>(header.clock_overhead);
+    clock_jitter_   = static_cast<type>(header.clock_jitter);
+    iterations_     = static_cast<std::size_t>(header.iterations);
+    return true;
   }
 
-  std::string       name  ;
-  std::vector<type> values;
+  mapped_file                    file_           ;
+  std::vector<record_view<type>> records_        ;
+  std::vector<std::vector<type>> decoded_        ;
+  type                           clock_overhead_ = type(0);
+  type                           clock_jitter_   = type(0);
+  std::size_t                    iterations_     = 0;
+  bool                           valid_          = false;
+};
+
+// Thresholds of a regression check. A record regressed if it is significantly slower than its baseline at level alpha, and its mean
+// exceeds the mean of the baseline by more than tolerance (relative), so that significant but negligible slowdowns pass.
+struct regression_criteria
+{
+  double alpha                = 0.05;
+  double tolerance            = 0.05;
+  // Whether a record of the baseline which is absent from the current session fails the check.
+  bool   fail_on_missing      = false;
+  // Whether a record which cannot be compared to the baseline fails the check.
+  bool   fail_on_incomparable = true;
+};
+
+enum class verdict
+{
+  unchanged,
+  improved ,
+  regressed,
+  missing     , // In the baseline only.
+  added       , // In the current session only.
+  incomparable  // Of different units, or with less than two samples on either side, e.g. a histogram read back from csv.
 };
 
 template <typename type = double>
-struct session
+struct regression_report
 {
-  virtual ~session() = default;
+  struct entry
+  {
+    std::string          name      ;
+    bm::verdict          verdict   ;
+    bm::comparison<type> comparison;
+  };
 
-  virtual std::string to_string() const
+  constexpr bool        passed   () const
+  {
+    return std::none_of(entries.begin(), entries.end(), [&] (const entry& entry)
+    {
+      return entry.verdict == verdict::regressed || 
+            (entry.verdict == verdict::missing      && criteria.fail_on_missing     ) || 
+            (entry.verdict == verdict::incomparable && criteria.fail_on_incomparable);
+    });
+  }
+
+  std::string           to_string() const
   {
+    static constexpr const char* verdicts[] = {"unchanged", "improved", "regressed", "missing", "added", "incomparable"};
+
     std::ostringstream stream;
-    for (auto& record : records)
-      stream << record.to_string() << "\n";
+    stream.precision(std::numeric_limits<type>::max_digits10);
+    for (auto& entry : entries)
+    {
+      write_csv_field(stream, entry.name);
+      stream << "," << verdicts[static_cast<std::size_t>(entry.verdict)] << ",";
+      stream << entry.comparison.speedup << "," << entry.comparison.speedup_interval.lower << "," << entry.comparison.speedup_interval.upper << ",";
+      stream << entry.comparison.welch_p << "," << entry.comparison.mann_whitney_p << "\n";
+    }
     return stream.str();
   }
-  virtual void        to_csv   (const std::string& filepath) const
+  static std::string    header   ()
+  {
+    return "name,verdict,speedup,speedup lower bound,speedup upper bound,welch p,mann-whitney p";
+  }
+  void                  to_csv   (const std::string& filepath) const
   {
     std::ofstream stream(filepath);
-    stream << "name,";
-    for (std::size_t i = 0; i < records[0].values.size(); ++i)
-      stream << "run_" << i << ",";
-    stream << "mean,variance,standard deviation\n";
+    stream << header() << "\n";
     stream << to_string();
   }
 
-  std::vector<record<type>> records;
+  regression_criteria criteria;
+  std::vector<entry>  entries ;
 };
 
+// Compares every record of the current session to the record of the same name in the baseline (see compare), for instance a
+// session stored by a previous run and read through session::from_csv.
+template <typename type = double>
+regression_report<type> detect_regressions(const session<type>& baseline, const session<type>& current, const regression_criteria& criteria = regression_criteria())
+{
+  regression_report<type> report;
+  report.criteria = criteria;
+  for (auto& record : current.records)
+  {
+    const auto index = baseline.find(record.name);
+    if (index == baseline.records.size())
+    {
+      report.entries.push_back({record.name, verdict::added, comparison<type>()});
+      continue;
+    }
+
+    // Records of unknown unit (e.g. read from a csv without a unit column) are assumed to share the unit of the other.
+    const auto& reference = baseline.records[index];
+    if ((!reference.unit.empty() && !record.unit.empty() && reference.unit != record.unit) || reference.count() < 2 || record.count() < 2)
+    {
+      report.entries.push_back({record.name, verdict::incomparable, comparison<type>()});
+      continue;
+    }
+
+    const auto result  = compare(reference, record);
+    const auto slowed  = result.slower(criteria.alpha) && result.speedup < type(1.0 / (1.0 + criteria.tolerance));
+    const auto sped_up = result.faster(criteria.alpha) && result.speedup > type(1.0 + criteria.tolerance);
+    report.entries.push_back({record.name, slowed ? verdict::regressed : sped_up ? verdict::improved : verdict::unchanged, result});
+  }
+  for (auto& record : baseline.records)
+    if (current.find(record.name) == current.records.size())
+      report.entries.push_back({record.name, verdict::missing, comparison<type>()});
+  return report;
+}
+
 #ifdef BM_MPI_SUPPORT
 template <typename type = double>
 class  mpi_session : public session<type>
@@ -105,120 +3151,734 @@ public:
   
   void                gather   ()
   {
+    // The header is shared by the records of every rank.
+    const auto local = this->layout();
+    std::uint64_t local_columns[4] = {local.values, local.thread_cpu_values, local.process_cpu_values, local.threads}, columns[4] {};
+    MPI_Allreduce(local_columns, columns, 4, MPI_UNSIGNED_LONG_LONG, MPI_MAX, communicator_);
+    layout_ = {static_cast<std::size_t>(columns[0]), static_cast<std::size_t>(columns[1]), static_cast<std::size_t>(columns[2]), static_cast<std::size_t>(columns[3])};
+
     std::ostringstream stream;
-    for (auto& record : records) 
-      stream << rank_ << "," << record.to_string() << "\n";
-    std::string  local_string = stream      .str ();
-    std::int32_t local_size   = local_string.size();
-    
-    std::vector<std::int32_t> sizes        (size_);
-    std::vector<std::int32_t> displacements(size_);
-    std::int32_t              counter = 0;
-    MPI_Gather (&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, master_rank_, communicator_);
-    for (auto i = 0; i < size_; ++i)
-      displacements[i] = counter, counter += sizes[i];
-    gathered_.resize(counter);
-    MPI_Gatherv(local_string.data(), local_string.size(), MPI_CHAR, gathered_.data(), sizes.data(), displacements.data(), MPI_CHAR, master_rank_, communicator_);
+    {
+      buffered_writer writer(stream);
+      for (auto& record : this->records) 
+      {
+        writer << rank_ << ',';
+        record.write_row(writer, layout_);
+        writer << '\n';
+      }
+    }
+    gathered_ = gather_string(stream.str());
   }
+  // Reads the records of this rank from a csv written by to_csv.
+  static mpi_session  from_csv (const std::string& filepath, MPI_Comm communicator = MPI_COMM_WORLD, std::int32_t master_rank = 0)
+  {
+    mpi_session result(communicator, master_rank);
+    record<type>::parse_csv(filepath, [&] (const std::int64_t rank, record<type>&& record)
+    {
+      if (rank != result.rank_)
+        return;
+      result.iterations = std::max(result.iterations, record.iterations);
+      result.insert(std::move(record));
+    });
+    return result;
+  }
+
   virtual std::string to_string()                            const override
   {
     return rank_ == master_rank_ ? gathered_ : session<type>::to_string();
   }
+  // Collective. The entries of each rank are named record/rank:r, with the index of the record as family and the rank as instance.
+  virtual void        to_json  (const std::string& filepath, const bool aggregates_only = false) const override
+  {
+    std::ostringstream local;
+    {
+      buffered_writer writer(local);
+      for (std::size_t i = 0; i < this->records.size(); ++i)
+      {
+        writer << ",\n";
+        this->records[i].write_json(writer, this->records[i].name + "/rank:" + std::to_string(rank_), i, static_cast<std::size_t>(rank_), aggregates_only);
+      }
+    }
+    const auto entries = gather_string(local.str());
+    if (rank_ != master_rank_)
+      return;
+
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "{\n";
+    system_context::query().write_json(writer);
+    writer << ",\n  \"benchmarks\": [\n" << std::string_view(entries).substr(std::min<std::size_t>(entries.size(), 2)) << "\n  ]\n}\n";
+  }
+  // Collective. The events of each rank are written as the process of that rank. The timeline origin is per process, hence the
+  // timelines of ranks on different nodes are not aligned.
+  virtual void        to_trace (const std::string& filepath) const override
+  {
+    std::ostringstream local;
+    {
+      buffered_writer writer(local);
+      this->write_trace_events(writer, rank_, false);
+    }
+    const auto events = gather_string(local.str());
+    if (rank_ != master_rank_)
+      return;
+
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "{\"traceEvents\":[\n" << std::string_view(events).substr(std::min<std::size_t>(events.size(), 2)) << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  }
   virtual void        to_csv   (const std::string& filepath) const override
   {
     if (rank_ != master_rank_)
       return;
 
-    std::ofstream stream(filepath);
-    stream << "rank,name,";
-    for (auto i = 0; i < records[0].values.size(); ++i)
-      stream << "run_" << i << ",";
-    stream << "mean,variance,standard deviation\n";
-    stream << to_string();
+    std::ofstream   stream(filepath, std::ios::binary);
+    buffered_writer writer(stream);
+    writer << "rank,";
+    record<type>::write_header(writer, layout_);
+    writer << '\n' << gathered_;
   }
   
 protected:
+  // Concatenates the strings of every rank in rank order on the master rank.
+  std::string         gather_string(const std::string& local) const
+  {
+    std::int32_t              local_size = static_cast<std::int32_t>(local.size());
+    std::vector<std::int32_t> sizes        (size_);
+    std::vector<std::int32_t> displacements(size_);
+    std::int32_t              counter = 0;
+    MPI_Gather (&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, master_rank_, communicator_);
+    for (auto i = 0; i < size_; ++i)
+      displacements[i] = counter, counter += sizes[i];
+    std::string result(rank_ == master_rank_ ? counter : 0, '\0');
+    MPI_Gatherv(local.data(), local_size, MPI_CHAR, result.data(), sizes.data(), displacements.data(), MPI_CHAR, master_rank_, communicator_);
+    return result;
+  }
+
   MPI_Comm     communicator_;
   std::int32_t master_rank_ ;
   std::int32_t rank_        ;
   std::int32_t size_        ;
   std::string  gathered_    ;
+  csv_layout   layout_      ;
 };
 #endif
 
-template <typename type = double, typename period = std::milli>
+// Origin of the timestamps of the timeline, fixed on first use within the process.
+template <typename clock = std::chrono::high_resolution_clock>
+const typename clock::time_point& timeline_origin()
+{
+  static const auto origin = clock::now();
+  return origin;
+}
+// Small identifier of the calling thread, assigned on first use. The identifier of an exited thread is reused by the next thread
+// requesting one, hence the identifiers (and the recorder buffers kept for them) are bounded by the number of threads alive at once.
+inline std::uint32_t              thread_index   ()
+{
+  struct registry
+  {
+    std::mutex                 mutex   ;
+    std::uint32_t              next     = 0;
+    std::vector<std::uint32_t> released;
+  };
+  static registry instance;
+
+  struct lease
+  {
+    lease ()
+    {
+      std::lock_guard<std::mutex> lock(instance.mutex);
+      if (instance.released.empty())
+      {
+        index = instance.next++;
+        return;
+      }
+      const auto smallest = std::min_element(instance.released.begin(), instance.released.end());
+      index = *smallest;
+      instance.released.erase(smallest);
+    }
+   ~lease ()
+    {
+      std::lock_guard<std::mutex> lock(instance.mutex);
+      instance.released.push_back(index);
+    }
+
+    std::uint32_t index = 0;
+  };
+  thread_local const lease current;
+  return current.index;
+}
+
+// Reads the processor time clocks before the wall clock on construction, and after it on stop.
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+class  stopwatch
+{
+public:
+  // The clocks are read nested, the processor time clocks outside the wall clock, and the timeline origin is fixed before any of them,
+  // hence each interval contains the reads of the clocks within it but nothing else.
+  explicit stopwatch(const options& options) : options_(options)
+  {
+    if (options_.timeline)
+      timeline_origin<clock>();
+    if (options_.capture_process_cpu_time)
+      process_start_ = process_cpu_clock::now();
+    if (options_.capture_thread_cpu_time)
+      thread_start_  = thread_cpu_clock ::now();
+    start_ = clock::now();
+  }
+
+  // The end time points of the clocks. Read apart from stop by callers which have to locate the stopwatch first.
+  struct reading
+  {
+    typename clock   ::time_point end        ;
+    thread_cpu_clock ::time_point thread_end ;
+    process_cpu_clock::time_point process_end;
+  };
+  static reading read(const options& options)
+  {
+    reading result;
+    result.end         = clock::now();
+    if (options.capture_thread_cpu_time)
+      result.thread_end  = thread_cpu_clock ::now();
+    if (options.capture_process_cpu_time)
+      result.process_end = process_cpu_clock::now();
+    return result;
+  }
+
+  sample<type> stop() const
+  {
+    return stop(read(options_));
+  }
+  // The reads of the clocks within each processor time interval are subtracted from it (by their estimates, see clock_overhead) if the
+  // overhead is subtracted, as the one of the wall clock is subtracted from the wall time by the callers.
+  sample<type> stop(const reading& reading) const
+  {
+    const auto& [end, thread_end, process_end] = reading;
+
+    sample<type> result;
+    result.wall          = std::chrono::duration<type, period>(end - start_).count();
+    if (options_.timeline)
+      result.start       = std::chrono::duration<type, period>(start_ - timeline_origin<clock>()).count();
+
+    const auto overhead  = [&] (const auto& duration) { return std::chrono::duration<type, period>(duration).count(); };
+    auto       nested    = options_.subtract_overhead ? overhead(clock_overhead<clock>().mean) : type(0);
+    if (options_.capture_thread_cpu_time)
+    {
+      nested            += options_.subtract_overhead ? overhead(clock_overhead<thread_cpu_clock>().mean) : type(0);
+      result.thread_cpu  = std::max(std::chrono::duration<type, period>(thread_end  - thread_start_ ).count() - nested, type(0));
+    }
+    if (options_.capture_process_cpu_time)
+    {
+      nested            += options_.subtract_overhead ? overhead(clock_overhead<process_cpu_clock>().mean) : type(0);
+      result.process_cpu = std::max(std::chrono::duration<type, period>(process_end - process_start_).count() - nested, type(0));
+    }
+    return result;
+  }
+
+  // Estimates the overheads subtracted by stop ahead of the first sample, which would otherwise pay for it.
+  static void  calibrate(const options& options)
+  {
+    if (!options.subtract_overhead)
+      return;
+    clock_overhead<clock>();
+    if (options.capture_thread_cpu_time)
+      clock_overhead<thread_cpu_clock >();
+    if (options.capture_process_cpu_time)
+      clock_overhead<process_cpu_clock>();
+  }
+
+protected:
+  const options&                options_      ;
+  thread_cpu_clock ::time_point thread_start_ ;
+  process_cpu_clock::time_point process_start_;
+  typename clock   ::time_point start_        ;
+};
+
+// Times batch_size consecutive calls to the function.
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+sample<type>      measure(function_type&& function, const std::size_t batch_size, const options& options)
+{
+  const stopwatch<type, period, clock> watch(options);
+  for (std::size_t j = 0; j < batch_size; ++j)
+    invoke_and_sink(function);
+  return watch.stop();
+}
+
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+class  scoped_section;
+
+// Per thread buffers of the session_recorders of a session. Owned by record_session across iterations, so that each thread allocates and
+// reserves its buffer once rather than in the recorder of every iteration.
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+struct recorder_state
+{
+  struct frame
+  {
+    std::size_t                    index ;
+    type                           nested; // Time of the nested sections.
+    stopwatch<type, period, clock> watch ;
+  };
+  struct entry
+  {
+    std::size_t                    index    ;
+    bm::sample<type>               sample   ;
+    type                           exclusive;
+  };
+  // Sections being recorded and sections recorded by a thread, appended to the session when each recorder is destroyed.
+  struct buffer
+  {
+    std::uint32_t                                             thread  ;
+    std::vector<frame>                                        stack   ;
+    std::vector<entry>                                        entries ;
+    std::vector<timeline_event<type>>                         timeline;
+    std::vector<std::unordered_map<std::string, std::size_t>> handles ; // Handles by name at the top level, then within each record.
+  };
+
+  static std::uint64_t next_id()
+  {
+    static std::atomic<std::uint64_t> counter {0};
+    return ++counter;
+  }
+
+  std::size_t                          sections = 0    ; // Number of sections reserved in each buffer.
+  std::size_t                          entries  = 0    ; // Most entries a buffer held at a merge, also reserved for the buffers of new threads.
+  std::atomic<std::size_t>             records  {0}    ; // Number of records known to exist, read without the lock to validate handles.
+  bool                                 timeline = false;
+  const std::uint64_t                  id       = next_id();
+  std::mutex                           mutex    ;
+  std::vector<std::unique_ptr<buffer>> buffers  ;
+};
+
+template <typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
 class  session_recorder
 {
 public:
   explicit session_recorder  (const std::size_t index, const std::size_t iterations, session<type>& session) 
-  : index_(index), iterations_(iterations), session_(session)
+  : index_(index), iterations_(iterations), session_(session), options_(default_options())
+  , owned_state_(std::make_unique<recorder_state<type, period, clock>>()), state_(owned_state_.get())
+  {
+
+  }
+  // Warmup recorders execute and time the functions, but discard the samples.
+  explicit session_recorder  (const std::size_t index, session<type>& session, const options& options, const bool warmup = false) 
+  : index_(index), iterations_(options.iterations), session_(session), options_(options), warmup_(warmup)
+  , owned_state_(std::make_unique<recorder_state<type, period, clock>>()), state_(owned_state_.get())
+  {
+    owned_state_->sections = options.sections.size();
+    owned_state_->timeline = options.timeline;
+  }
+  // Recorders sharing a state reuse its thread buffers, hence must not be alive at the same time.
+  explicit session_recorder  (const std::size_t index, session<type>& session, const options& options, recorder_state<type, period, clock>& state, const bool warmup = false) 
+  : index_(index), iterations_(options.iterations), session_(session), options_(options), warmup_(warmup), state_(&state)
   {
 
   }
   session_recorder           (const session_recorder&  that) = delete ;
-  session_recorder           (      session_recorder&& temp) = default;
-  virtual ~session_recorder  ()                              = default;
+  // The state is held by pointer, hence moves keep the thread buffers and the sections being recorded. The moved from recorder merges
+  // nothing on destruction, and must not be used otherwise, nor be the recorder of a scoped_section alive across the move.
+  session_recorder           (      session_recorder&& temp) noexcept
+  : index_(temp.index_), iterations_(temp.iterations_), session_(temp.session_), options_(temp.options_), warmup_(temp.warmup_)
+  , owned_state_(std::move(temp.owned_state_)), state_(std::exchange(temp.state_, nullptr))
+  {
+
+  }
+  virtual ~session_recorder  ()
+  {
+    if (state_)
+      merge();
+  }
   session_recorder& operator=(const session_recorder&  that) = delete ;
-  session_recorder& operator=(      session_recorder&& temp) = default;
+  session_recorder& operator=(      session_recorder&& temp) = delete ;
   
-  void record(const std::string& name, const std::function<void()>& function)
+  // Returns the handle of the record with the given name, creating the record if necessary. Within a recorded section, the record is
+  // nested in the record of that section and named by its path, e.g. "outer/inner".
+  // Creation allocates the values of all iterations, and happens before the function is timed. Safe to call from any thread.
+  // Handles are cached per thread, hence a name is resolved under a lock only the first time a thread requests it within a record.
+  bm::handle handle(const std::string& name)
   {
-    const auto start = std::chrono::high_resolution_clock::now();
-    function();
-    const auto end   = std::chrono::high_resolution_clock::now();
+    auto& buffer = local();
+
+    std::optional<std::size_t> parent;
+    if (!buffer.stack.empty())
+      parent = buffer.stack.back().index;
+    const auto slot = parent ? *parent + 1 : 0;
+    if (slot < buffer.handles.size())
+    {
+      auto iterator = buffer.handles[slot].find(name);
+      if (iterator != buffer.handles[slot].end())
+        return {iterator->second};
+    }
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    const auto path  = parent ? session_.records[*parent].name + "/" + name : name;
+    auto       index = session_.find(path);
+    if (index == session_.records.size())
+    {
+      auto record = make_record<type, period, clock>(path, options_, iterations_);
+      record.clock_overhead = session_.clock_overhead;
+      record.clock_jitter   = session_.clock_jitter  ;
+      record.parent         = parent ? parent : session_.find_parent(path);
+      record.threads.reserve(record.values.capacity());
+      index = session_.insert(std::move(record));
+      state_->records.store(session_.records.size(), std::memory_order_release);
+    }
+    if (slot >= buffer.handles.size())
+      buffer.handles.resize(std::max(slot + 1, session_.records.size() + 1));
+    buffer.handles[slot].emplace(name, index);
+    return {index};
+  }
+
+  // Starts timing the section of the handle. Sections started on the same thread before it stops are nested in it.
+  // Throws std::out_of_range if the handle does not identify a record of the session, e.g. if made up from an index.
+  void start(const bm::handle handle)
+  {
+    if (handle.index >= state_->records.load(std::memory_order_acquire))
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      state_->records.store(session_.records.size(), std::memory_order_release);
+      if (handle.index >= session_.records.size())
+        throw std::out_of_range("The handle does not identify a record of the session.");
+    }
+    auto& stack = local().stack;
+    stack.push_back({handle.index, type(0), stopwatch<type, period, clock>(options_)});
+  }
+  // Stops timing the section of the handle and records it. Ignored unless it is the latest started section of the thread.
+  void stop (const bm::handle handle)
+  {
+    // The clocks are read before the buffer of the thread is looked up, which the sample would contain otherwise.
+    const auto reading = stopwatch<type, period, clock>::read(options_);
+    auto&      buffer  = local();
+    auto&      stack   = buffer.stack;
+    if (stack.empty() || stack.back().index != handle.index)
+      return;
+    auto       sample = stack.back().watch.stop(reading);
+    sample.thread     = buffer.thread;
+    const auto nested = stack.back().nested;
+    stack.pop_back();
+    // Warmup samples are buffered as others and discarded by merge, hence the buffers grow to the entries of an iteration before timing.
+    if (sample.start)
+      buffer.timeline.push_back({handle.index, index_, buffer.thread, *sample.start, *sample.start + sample.wall});
+    if (options_.subtract_overhead)
+      sample.wall = std::max(sample.wall - session_.clock_overhead, type(0));
+    // The time of nested sections is accumulated in the frame of the enclosing section as recorded, i.e. after the overhead is subtracted
+    // from it as from the enclosing section, hence the exclusive time is the recorded time less the recorded times of the nested ones.
+    if (!stack.empty())
+      stack.back().nested += sample.wall;
+    buffer.entries.push_back({handle.index, sample, std::max(sample.wall - nested, type(0))});
+  }
+
+  // Returns a guard recording the section from its construction to its destruction.
+  scoped_section<type, period, clock> scope(const bm::handle   handle)
+  {
+    return scoped_section<type, period, clock>(*this, handle);
+  }
+  scoped_section<type, period, clock> scope(const std::string& name  )
+  {
+    return scoped_section<type, period, clock>(*this, handle(name));
+  }
+
+  template <typename function_type>
+  void record(const bm::handle   handle, function_type&& function)
+  {
+    start(handle);
+    invoke_and_sink(function);
+    stop (handle);
+  }
+  template <typename function_type>
+  void record(const std::string& name  , function_type&& function)
+  {
+    record(handle(name), std::forward<function_type>(function));
+  }
+  void record(const std::string& name  , const std::function<void()>& function)
+  {
+    record<const std::function<void()>&>(name, function);
+  }
+
+protected:
+  using buffer = typename recorder_state<type, period, clock>::buffer;
+
+  static const options& default_options()
+  {
+    static const options instance;
+    return instance;
+  }
 
-    auto record = std::find_if(session_.records.begin(), session_.records.end(),
-      [&name] (const bm::record<type>& record) { return record.name == name; });
-    if (record == session_.records.end())
+  // The buffer of the calling thread. The lock is only taken on the first call of each thread, later calls hit the thread local cache.
+  buffer&               local          ()
+  {
+    thread_local std::pair<std::uint64_t, buffer*> cache {0, nullptr};
+    if (cache.first != state_->id)
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      const auto thread   = thread_index();
+      auto&      buffers  = state_->buffers;
+      auto       iterator = std::find_if(buffers.begin(), buffers.end(), [thread] (const std::unique_ptr<buffer>& buffer) { return buffer->thread == thread; });
+      if (iterator == buffers.end())
+      {
+        // The buffer is reserved once for the sections known ahead, or the most entries a thread recorded so far if more, so that
+        // recording does not allocate while other sections are timed.
+        const auto reserved = std::max<std::size_t>({state_->sections, state_->entries, 8});
+        iterator = buffers.insert(buffers.end(), std::make_unique<buffer>());
+        (*iterator)->thread = thread;
+        (*iterator)->handles.resize (state_->sections + 1);
+        (*iterator)->stack  .reserve(reserved);
+        (*iterator)->entries.reserve(reserved);
+        if (state_->timeline)
+          (*iterator)->timeline.reserve(reserved);
+      }
+      cache = {state_->id, iterator->get()};
+    }
+    return *cache.second;
+  }
+  // Appends the samples of each thread to the records, in the order the threads first recorded, unless warming up. The buffers keep
+  // their capacity, and grow to the most entries any of them held, as the threads may share the work differently in the next iteration.
+  void                  merge          ()
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto& buffer : state_->buffers)
     {
-      session_.records.push_back({name, {std::vector<type>(iterations_)}});
-      record = std::prev(session_.records.end());
+      state_->entries = std::max(state_->entries, buffer->entries.size());
+      if (!warmup_)
+      {
+        for (auto& entry : buffer->entries)
+        {
+          auto& record = session_.records[entry.index];
+          record.add(entry.sample);
+          record.exclusive_statistics.add(entry.exclusive);
+        }
+        session_.timeline.insert(session_.timeline.end(), buffer->timeline.begin(), buffer->timeline.end());
+      }
+      buffer->stack   .clear();
+      buffer->entries .clear();
+      buffer->timeline.clear();
+      buffer->entries .reserve(state_->entries);
+      if (state_->timeline)
+        buffer->timeline.reserve(state_->entries);
     }
-    record->values[index_] = std::chrono::duration<type, period>(end - start).count();
   }
 
+  const std::size_t                   index_       ;
+  const std::size_t                   iterations_  ;
+  session<type>&                      session_     ;
+  const options&                      options_     ;
+  const bool                          warmup_      = false;
+  std::unique_ptr<recorder_state<type, period, clock>> owned_state_; // Used unless the state is shared by the caller.
+  recorder_state<type, period, clock>*                 state_      ;
+};
+
+template <typename type, typename period, typename clock>
+class  scoped_section
+{
+public:
+  explicit scoped_section  (session_recorder<type, period, clock>& recorder, const bm::handle handle)
+  : recorder_(recorder), handle_(handle)
+  {
+    recorder_.start(handle_);
+  }
+  explicit scoped_section  (session_recorder<type, period, clock>& recorder, const std::string& name)
+  : scoped_section(recorder, recorder.handle(name))
+  {
+
+  }
+  scoped_section           (const scoped_section&  that) = delete;
+  scoped_section           (      scoped_section&& temp) = delete;
+ ~scoped_section           ()
+  {
+    recorder_.stop(handle_);
+  }
+  scoped_section& operator=(const scoped_section&  that) = delete;
+  scoped_section& operator=(      scoped_section&& temp) = delete;
+
 protected:
-  const std::size_t index_     ;
-  const std::size_t iterations_;
-  session<type>&    session_   ;
+  session_recorder<type, period, clock>& recorder_;
+  const bm::handle                       handle_  ;
 };
 
-template<typename type = double, typename period = std::milli>
-record<type>      run    (const std::function<void()>&                                function, const std::size_t iterations = 1)
+// Whether the record satisfies every precision criterion enabled in the options.
+template<typename type = double>
+bool              converged      (const record<type>& record, const options& options)
+{
+  if (options.target_relative_standard_error > 0.0 && !(record.relative_standard_error() < options.target_relative_standard_error))
+    return false;
+  if (options.target_confidence_interval     > 0.0 && !(record.confidence_interval(static_cast<type>(options.confidence_level)).width() / std::abs(record.mean()) < options.target_confidence_interval))
+    return false;
+  return true;
+}
+// Whether a run started at the given time may stop after the given number of iterations, before options.iterations.
+// The predicate tells whether the records converged.
+template<typename predicate_type>
+bool              stop_early     (const options& options, const std::chrono::steady_clock::time_point start, const std::size_t iterations, predicate_type&& predicate)
+{
+  if (options.time_budget.count() > 0 && std::chrono::steady_clock::now() - start >= options.time_budget)
+    return true;
+  if (!(options.target_relative_standard_error > 0.0 || options.target_confidence_interval > 0.0) || iterations < options.min_iterations)
+    return false;
+  // Each check costs a quantile of the t distribution, and with outliers excluded a reclassification of the samples in linear time,
+  // which may well exceed an iteration of a short function. Hence the checks are spaced by up to an eighth of the iterations (a power
+  // of two), which keeps their number logarithmic and their total cost linear in the number of iterations.
+  std::size_t step = 1;
+  while (step * 16 <= iterations)
+    step *= 2;
+  if (iterations % step != 0)
+    return false;
+  return predicate();
+}
+
+template<typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::size_t       calibrate_batch(function_type&& function, const std::chrono::nanoseconds target, const std::size_t limit)
 {
-  record<type> record {"benchmark", std::vector<type>(iterations)};
-  for (std::size_t i = 0; i < iterations; ++i)
+  std::size_t batch_size = 1;
+  for (; batch_size < limit; batch_size *= 2)
   {
-    const auto start = std::chrono::high_resolution_clock::now();
-    function();
-    const auto end   = std::chrono::high_resolution_clock::now();
-    record.values[i] = std::chrono::duration<type, period>(end - start).count();
+    const auto start = clock::now();
+    for (std::size_t j = 0; j < batch_size; ++j)
+      invoke_and_sink(function);
+    const auto end   = clock::now();
+    if (end - start >= target)
+      break;
+  }
+  return std::min(batch_size, limit);
+}
+
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&>, record<type>>
+                  run    (function_type&&                                             function, const options&    options   )
+{
+  auto record = make_record<type, period, clock>("benchmark", options, options.iterations);
+  record.clock_overhead = std::chrono::duration<type, period>(clock_overhead<clock>().mean              ).count();
+  record.clock_jitter   = std::chrono::duration<type, period>(clock_overhead<clock>().standard_deviation).count();
+  stopwatch<type, period, clock>::calibrate(options);
+  if (options.batch)
+    record.batch_size = calibrate_batch<clock>(function, options.batch_target, options.batch_limit);
+
+  for (std::size_t i = 0; i < options.warmup; ++i)
+    measure<type, period, clock>(function, record.batch_size, options);
+
+  const auto subtrahend = options.subtract_overhead ? record.clock_overhead : type(0);
+  const auto batch_size = static_cast<type>(record.batch_size);
+  const auto start      = std::chrono::steady_clock::now();
+  const auto predicate  = [&record, &options] { return converged(record, options); };
+  for (; record.iterations < options.iterations && (record.iterations == 0 || !stop_early(options, start, record.iterations, predicate)); ++record.iterations)
+  {
+    auto sample = measure<type, period, clock>(function, record.batch_size, options);
+    sample.wall = std::max(sample.wall - subtrahend, type(0)) / batch_size;
+    if (sample.thread_cpu )
+      *sample.thread_cpu  /= batch_size;
+    if (sample.process_cpu)
+      *sample.process_cpu /= batch_size;
+    record.add(sample);
   }
   return record;
 }
-template<typename type = double, typename period = std::milli>
-session<type>     run    (const std::function<void(session_recorder<type, period>&)>& function, const std::size_t iterations = 1)
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&>, record<type>>
+                  run    (function_type&&                                             function, const std::size_t iterations = 1)
 {
-  session<type> session;
-  for(std::size_t i = 0; i < iterations; ++i)
+  bm::options options;
+  options.iterations = iterations;
+  return run<type, period, clock>(function, options);
+}
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+void              record_session(function_type&& function, const options& options, session<type>& session)
+{
+  session.clock_overhead = std::chrono::duration<type, period>(clock_overhead<clock>().mean              ).count();
+  session.clock_jitter   = std::chrono::duration<type, period>(clock_overhead<clock>().standard_deviation).count();
+  stopwatch<type, period, clock>::calibrate(options);
+
+  recorder_state<type, period, clock> state;
+  state.sections = options.sections.size();
+  state.timeline = options.timeline;
+  if (!options.sections.empty())
+  {
+    session.reserve(session.records.size() + options.sections.size());
+    session_recorder<type, period, clock> recorder(0, session, options, state);
+    for (auto& section : options.sections)
+      recorder.handle(section);
+    // Sections declared by path are nested in the section of their prefix, also when it is declared after them.
+    for (auto& record : session.records)
+      if (!record.parent)
+        record.parent = session.find_parent(record.name);
+  }
+  if (options.timeline)
+    session.timeline.reserve(session.timeline.size() + reserved_iterations(options, options.iterations) * std::max<std::size_t>(options.sections.size(), 1));
+  for (std::size_t i = 0; i < options.warmup; ++i)
+  {
+    session_recorder<type, period, clock> recorder(i, session, options, state, true);
+    function(recorder);
+  }
+
+  const auto start     = std::chrono::steady_clock::now();
+  // Records with fewer than two samples (e.g. declared but unused sections, or sections skipped so far) have no precision to check and
+  // are left out, rather than keeping the run from ever stopping early.
+  const auto predicate = [&session, &options]
+  {
+    std::size_t checked = 0;
+    for (auto& record : session.records)
+    {
+      if (record.count() < 2)
+        continue;
+      if (!converged(record, options))
+        return false;
+      ++checked;
+    }
+    return checked > 0;
+  };
+  for (; session.iterations < options.iterations && (session.iterations == 0 || !stop_early(options, start, session.iterations, predicate)); ++session.iterations)
   {
-    session_recorder<type, period> recorder(i, iterations, session);
+    session_recorder<type, period, clock> recorder(session.iterations, session, options, state);
     function(recorder);
   }
+  for (auto& record : session.records)
+    record.iterations = session.iterations;
+}
+
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&, session_recorder<type, period, clock>&>, session<type>>
+                  run    (function_type&&                                             function, const options&    options   )
+{
+  session<type> session;
+  record_session<type, period, clock>(function, options, session);
   return session;
 }
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&, session_recorder<type, period, clock>&>, session<type>>
+                  run    (function_type&&                                             function, const std::size_t iterations = 1)
+{
+  bm::options options;
+  options.iterations = iterations;
+  return run<type, period, clock>(function, options);
+}
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+record<type>      run    (const std::function<void()>&                                function, const std::size_t iterations = 1)
+{
+  return run<type, period, clock, const std::function<void()>&>(function, iterations);
+}
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+session<type>     run    (const std::function<void(session_recorder<type, period, clock>&)>& function, const std::size_t iterations = 1)
+{
+  return run<type, period, clock, const std::function<void(session_recorder<type, period, clock>&)>&>(function, iterations);
+}
 #ifdef BM_MPI_SUPPORT
-template<typename type = double, typename period = std::milli>
-mpi_session<type> run_mpi(const std::function<void(session_recorder<type, period>&)>& function, const std::size_t iterations = 1, const MPI_Comm communicator = MPI_COMM_WORLD, const std::int32_t master_rank = 0)
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&, session_recorder<type, period, clock>&>, mpi_session<type>>
+                  run_mpi(function_type&&                                             function, const options&    options   , const MPI_Comm communicator = MPI_COMM_WORLD, const std::int32_t master_rank = 0)
 {
   mpi_session<type> session(communicator, master_rank);
-  for (std::size_t i = 0; i < iterations; ++i)
-  {
-    session_recorder<type, period> recorder(i, iterations, session);
-    function(recorder);
-  }
+  record_session<type, period, clock>(function, options, session);
   return session;
 }
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock, typename function_type>
+std::enable_if_t<std::is_invocable_v<function_type&, session_recorder<type, period, clock>&>, mpi_session<type>>
+                  run_mpi(function_type&&                                             function, const std::size_t iterations = 1, const MPI_Comm communicator = MPI_COMM_WORLD, const std::int32_t master_rank = 0)
+{
+  bm::options options;
+  options.iterations = iterations;
+  return run_mpi<type, period, clock>(function, options, communicator, master_rank);
+}
+template<typename type = double, typename period = std::milli, typename clock = std::chrono::high_resolution_clock>
+mpi_session<type> run_mpi(const std::function<void(session_recorder<type, period, clock>&)>& function, const std::size_t iterations = 1, const MPI_Comm communicator = MPI_COMM_WORLD, const std::int32_t master_rank = 0)
+{
+  return run_mpi<type, period, clock, const std::function<void(session_recorder<type, period, clock>&)>&>(function, iterations, communicator, master_rank);
+}
 #endif
 }
 
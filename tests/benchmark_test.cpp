@@ -1,11 +1,29 @@
 #include "catch.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <bm/bm.hpp>
 
+volatile std::size_t bm_test_sink = 0;
+
 TEST_CASE("bm::run")
 {
   std::vector<std::size_t> buffer(100000);
@@ -38,4 +56,1166 @@ TEST_CASE("bm::run")
     auto standard_deviation = record.standard_deviation();
   }
   session.to_csv("output_multi.csv");
-}
\ No newline at end of file
+}
+
+TEST_CASE("bm::run callable overhead")
+{
+  // Each sample batches many calls, hence the clock overhead does not swamp the difference of the calls.
+  bm::options options;
+  options.iterations   = 100;
+  options.batch        = true;
+  options.batch_target = std::chrono::microseconds(100);
+
+  std::size_t counter = 0;
+  const std::function<void()> erased = [&counter] { bm_test_sink = ++counter; };
+
+  auto erased_record  = bm::run<double, std::nano>(erased, options);
+  auto inlined_record = bm::run<double, std::nano>([&counter] { bm_test_sink = ++counter; }, options);
+  REQUIRE(erased_record .batch_size    >  1);
+  REQUIRE(inlined_record.batch_size    >  1);
+  REQUIRE(erased_record .values.size() == options.iterations);
+  REQUIRE(inlined_record.values.size() == options.iterations);
+
+  // The difference of the means is the overhead of the type erased call per invocation.
+  const auto overhead_per_call = erased_record.mean() - inlined_record.mean();
+  REQUIRE(std::isfinite(overhead_per_call));
+
+  erased_record .name = "std::function";
+  inlined_record.name = "lambda";
+  bm::session<double> overhead;
+  overhead.records = {erased_record, inlined_record};
+  overhead.to_csv("output_callable_overhead.csv");
+  const auto reported = bm::session<double>::from_csv("output_callable_overhead.csv");
+  REQUIRE(reported.records.size()                                == 2);
+  REQUIRE(reported.records[0].mean() - reported.records[1].mean() == Approx(overhead_per_call));
+
+  const auto before = counter;
+  const std::function<void(bm::session_recorder<double, std::nano>&)> erased_session = [&counter] (auto& recorder)
+  {
+    recorder.record("increment", [&counter] { ++counter; });
+  };
+  const auto session = bm::run<double, std::nano>(erased_session, 10);
+  REQUIRE(session.records.size() == 1);
+  REQUIRE(counter                == before + 10);
+}
+
+TEST_CASE("bm::run batched")
+{
+  std::size_t counter = 0;
+
+  bm::options options;
+  options.iterations = 10;
+  options.batch      = true;
+  const auto record  = bm::run<double, std::nano>([&counter] { bm_test_sink = ++counter; }, options);
+  REQUIRE(record.batch_size    >  1);
+  REQUIRE(record.values.size() == options.iterations);
+  REQUIRE((record.mean()       <  std::chrono::duration<double, std::nano>(options.batch_target).count()));
+}
+
+TEST_CASE("bm::clock_overhead")
+{
+  const auto& overhead = bm::clock_overhead();
+  REQUIRE(overhead.mean              .count() >  0.0);
+  REQUIRE(overhead.standard_deviation.count() >= 0.0);
+
+  bm::options options;
+  options.iterations        = 100;
+  options.subtract_overhead = true;
+  const auto record  = bm::run<double, std::nano>([] { }, options);
+  REQUIRE(record.clock_overhead == Approx(overhead.mean.count()));
+  REQUIRE(std::all_of(record.values.begin(), record.values.end(), [] (const double value) { return value >= 0.0; }));
+
+  const auto session = bm::run<double, std::nano>([] (auto& recorder) { recorder.record("empty", [] { }); }, options);
+  REQUIRE(session.clock_overhead            == Approx(overhead.mean.count()));
+  REQUIRE(session.records[0].clock_overhead == session.clock_overhead);
+}
+
+TEST_CASE("bm::tsc_clock")
+{
+  const auto start = bm::tsc_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const auto end   = bm::tsc_clock::now();
+  REQUIRE(end - start >= std::chrono::milliseconds(9));
+  REQUIRE(std::is_floating_point_v<bm::tsc_clock::rep>);
+  if (bm::tsc_clock::invariant())
+    REQUIRE(bm::tsc_clock::frequency()                   >  0.0);
+  REQUIRE(bm::clock_overhead<bm::tsc_clock>().mean.count() >= 0.0);
+
+  std::vector<std::size_t> buffer(1000);
+  const auto record  = bm::run<double, std::micro, bm::tsc_clock>([&buffer] { std::iota(buffer.begin(), buffer.end(), 0); }, 10);
+  REQUIRE(record.values.size() == 10);
+
+  const auto session = bm::run<double, std::micro, bm::tsc_clock>([&buffer] (auto& recorder)
+  {
+    recorder.record("iota", [&buffer] { std::iota(buffer.begin(), buffer.end(), 0); });
+  }, 10);
+  REQUIRE(session.records[0].values.size() == 10);
+}
+
+TEST_CASE("bm::run cpu time")
+{
+  std::vector<std::size_t> buffer(100000);
+
+  bm::options options;
+  options.iterations               = 10;
+  options.capture_thread_cpu_time  = true;
+  options.capture_process_cpu_time = true;
+
+  const auto record = bm::run<double, std::milli>([&buffer] { std::iota(buffer.begin(), buffer.end(), 0); }, options);
+  REQUIRE(record.thread_cpu_values .size() == options.iterations);
+  REQUIRE(record.process_cpu_values.size() == options.iterations);
+  REQUIRE(std::accumulate(record.thread_cpu_values.begin(), record.thread_cpu_values.end(), 0.0) > 0.0);
+  record.to_csv("output_cpu_time.csv");
+
+  const auto session = bm::run<double, std::milli>([] (auto& recorder)
+  {
+    recorder.record("sleep", [] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+  }, options);
+  REQUIRE(session.records[0].thread_cpu_values.size() == options.iterations);
+  REQUIRE(session.records[0].thread_cpu_values[0]     <  session.records[0].values[0]);
+  session.to_csv("output_cpu_time_multi.csv");
+
+  // The reads of the nested clocks are subtracted from the processor times of an empty function, which do not go below zero.
+  REQUIRE(bm::clock_overhead<bm::thread_cpu_clock >().mean.count() >= 0.0);
+  REQUIRE(bm::clock_overhead<bm::process_cpu_clock>().mean.count() >= 0.0);
+  options.iterations        = 100;
+  options.subtract_overhead = true;
+  const auto empty = bm::run<double, std::nano>([] { }, options);
+  const auto nonnegative = [] (const std::vector<double>& values)
+  {
+    return std::all_of(values.begin(), values.end(), [] (const double value) { return value >= 0.0; });
+  };
+  REQUIRE(nonnegative(empty.thread_cpu_values ));
+  REQUIRE(nonnegative(empty.process_cpu_values));
+}
+
+TEST_CASE("bm::session_recorder handles")
+{
+  const std::size_t sections = 200;
+  std::vector<std::string> names(sections);
+  for (std::size_t i = 0; i < sections; ++i)
+    names[i] = "section_" + std::to_string(i);
+
+  bm::handle last {};
+  const auto session = bm::run<double, std::nano>([&] (auto& recorder)
+  {
+    for (auto& name : names)
+      recorder.record(name, [] { });
+    last = recorder.handle(names.back());
+    recorder.record(last, [] { });
+  }, 10);
+  REQUIRE(session.records.size()              == sections);
+  REQUIRE(last.index                          == sections - 1);
+  REQUIRE(session.find(names.back())          == sections - 1);
+  REQUIRE(session.find("missing")             == sections);
+  REQUIRE(session.records[last.index].name    == names.back());
+
+  auto copy = session;
+  copy.records.push_back({"appended", {}});
+  REQUIRE(copy.find("appended") == sections);
+
+  // Renaming a record in place leaves the index stale, which the lookup has to detect rather than report the record missing.
+  copy.records[1].name = "renamed";
+  REQUIRE(copy.find("renamed")  == 1);
+  REQUIRE(copy.find(names[1])   == copy.records.size());
+  REQUIRE(copy.find(names[2])   == 2);
+
+  // Lookups are guarded, hence threads may query a shared session whose index they rebuild.
+  copy.records[2].name = "renamed again";
+  const auto&              shared = copy;
+  std::vector<std::size_t> found(4);
+  std::vector<std::thread> readers;
+  for (std::size_t i = 0; i < found.size(); ++i)
+    readers.emplace_back([&shared, &found, i] { found[i] = shared.find("renamed again"); });
+  for (auto& reader : readers)
+    reader.join();
+  REQUIRE(found == std::vector<std::size_t>(4, 2));
+
+  // Names are cached per thread and per enclosing record, hence the same name resolves to a different record within another section.
+  std::vector<std::size_t> indices;
+  const auto nested = bm::run<double, std::nano>([&indices] (auto& recorder)
+  {
+    indices.push_back(recorder.handle("leaf").index);
+    recorder.record("outer", [&] { indices.push_back(recorder.handle("leaf").index); });
+    std::thread([&] { indices.push_back(recorder.handle("leaf").index); }).join();
+  }, 3);
+  REQUIRE(nested.records.size() == 3);
+  REQUIRE((indices == std::vector<std::size_t> {0, 2, 0, 0, 2, 0, 0, 2, 0}));
+  REQUIRE(nested.records[2].name == "outer/leaf");
+}
+
+TEST_CASE("bm::options sections")
+{
+  std::vector<std::size_t> buffer(1000);
+
+  bm::options options;
+  options.iterations = 10;
+  options.sections   = {"iota", "generate", "unused"};
+
+  const auto session = bm::run<double, std::micro>([&] (auto& recorder)
+  {
+    recorder.record(bm::handle {0}, [&buffer] { std::iota    (buffer.begin(), buffer.end(), 0);         });
+    recorder.record("generate"    , [&buffer] { std::generate(buffer.begin(), buffer.end(), std::rand); });
+    REQUIRE(recorder.handle("generate").index == 1);
+  }, options);
+  REQUIRE(session.records.size()           == 3);
+  REQUIRE(session.records[0].name          == "iota");
+  REQUIRE(session.records[1].name          == "generate");
+  REQUIRE(session.records[0].values.size()     == options.iterations);
+  REQUIRE(session.records[2].values.empty   ());
+  REQUIRE(session.records[2].values.capacity() >= options.iterations);
+
+  // Handles made up from an index beyond the records of the session are rejected before anything is recorded.
+  const auto invented = [&options] { return bm::run<double, std::micro>([ ] (auto& recorder) { recorder.record(bm::handle {3}, [ ] { }); }, options); };
+  REQUIRE_THROWS_AS(invented(), std::out_of_range);
+}
+
+TEST_CASE("bm::record statistics")
+{
+  bm::record<float> record {"statistics"};
+  double sum = 0.0, squared_sum = 0.0;
+  for (std::size_t i = 0; i < 1000000; ++i)
+  {
+    const auto value = 1000.0f + static_cast<float>(i % 7) * 0.1f;
+    record.add(value);
+    sum         += value;
+    squared_sum += static_cast<double>(value) * value;
+  }
+  const auto mean     = sum / 1000000.0;
+  const auto variance = squared_sum / 1000000.0 - mean * mean;
+  REQUIRE(record.mean    () == Approx(mean    ).epsilon(1e-6));
+  REQUIRE(record.variance() == Approx(variance).epsilon(1e-3));
+
+  bm::record<double> modified {"modified", {1.0, 2.0, 3.0}};
+  REQUIRE(modified.mean    () == Approx(2.0));
+  REQUIRE(modified.variance() == Approx(2.0 / 3.0));
+  modified.add(6.0);
+  REQUIRE(modified.mean    () == Approx(3.0));
+  REQUIRE(modified.median  () == Approx(2.5));
+
+  modified.values[3] = 10.0;
+  modified.invalidate();
+  REQUIRE(modified.mean    () == Approx(4.0));
+  REQUIRE(modified.median  () == Approx(2.5));
+  REQUIRE(modified.max     () == 10.0);
+  modified.values[0] = 20.0;
+  modified.invalidate();
+  REQUIRE(modified.median  () == Approx(6.5));
+}
+
+TEST_CASE("bm::session_recorder samples")
+{
+  // Each recorded section appends a sample: repeated sections contribute several samples per iteration, skipped sections none.
+  std::size_t iteration = 0;
+  const auto session = bm::run([&iteration] (bm::session_recorder<>& recorder)
+  {
+    recorder.record("repeated", [ ] { });
+    recorder.record("repeated", [ ] { });
+    if (iteration++ % 2 == 0)
+      recorder.record("skipped", [ ] { });
+  }, 4);
+
+  REQUIRE(session.iterations == 4);
+  REQUIRE(session.records[session.find("repeated")].values    .size() == 8);
+  REQUIRE(session.records[session.find("skipped" )].values    .size() == 2);
+  REQUIRE(session.records[session.find("skipped" )].iterations        == 4);
+
+  // Warmup iterations record into the buffers as others (sizing them for the sections of an iteration), but are discarded.
+  bm::options options;
+  options.iterations = 3;
+  options.warmup     = 2;
+  options.timeline   = true;
+  const auto warmed  = bm::run([ ] (bm::session_recorder<>& recorder)
+  {
+    for (std::size_t i = 0; i < 20; ++i)
+      recorder.record("repeated", [ ] { });
+  }, options);
+  REQUIRE(warmed.records[0].values.size() == 60);
+  REQUIRE(warmed.timeline         .size() == 60);
+  REQUIRE(warmed.timeline.front().iteration == 0);
+}
+
+TEST_CASE("bm::record percentiles")
+{
+  bm::record<double> record {"percentiles"};
+  for (auto i = 100; i > 0; --i)
+    record.add(static_cast<double>(i));
+
+  REQUIRE(record.min                () == 1.0  );
+  REQUIRE(record.max                () == 100.0);
+  REQUIRE(record.median             () == Approx(50.5 ));
+  REQUIRE(record.percentile(0.0)       == 1.0  );
+  REQUIRE(record.percentile(100.0)     == 100.0);
+  REQUIRE(record.percentile(99.0)      == Approx(99.01));
+  REQUIRE(record.interquartile_range() == Approx(49.5 ));
+  REQUIRE(record.values.front()        == 100.0);
+
+  record.add(1000.0);
+  REQUIRE(record.max                () == 1000.0);
+  REQUIRE(record.median             () == Approx(51.0));
+
+  // Concurrent readers share the sorted copy.
+  std::vector<std::thread> readers;
+  std::vector<double>      medians(4);
+  for (std::size_t i = 0; i < medians.size(); ++i)
+    readers.emplace_back([&record, &medians, i] { medians[i] = record.median() + record.median_absolute_deviation(); });
+  for (auto& reader : readers)
+    reader.join();
+  REQUIRE(std::all_of(medians.begin(), medians.end(), [&medians] (const double value) { return value == medians[0]; }));
+
+  for (const std::size_t size : {1, 2, 7, 10, 101})
+  {
+    bm::record<double> spread {"spread"};
+    for (std::size_t i = 0; i < size; ++i)
+      spread.add(static_cast<double>((i * 37) % 17) + static_cast<double>(i % 3) * 0.25);
+    std::vector<double> deviations;
+    for (auto& value : spread.values)
+      deviations.push_back(std::abs(value - spread.median()));
+    REQUIRE(spread.median_absolute_deviation() == Approx(bm::select_percentile(deviations, 50.0)));
+  }
+}
+
+TEST_CASE("bm::histogram")
+{
+  bm::histogram<double> histogram(1e-3, 1e3, 3);
+  for (auto i = 1; i <= 10000; ++i)
+    histogram.add(static_cast<double>(i) * 1e-2);
+  REQUIRE(histogram.count()            == 10000);
+  REQUIRE(histogram.percentile(50.0)   == Approx(50.0 ).epsilon(1e-3));
+  REQUIRE(histogram.percentile(99.0)   == Approx(99.0 ).epsilon(1e-3));
+  REQUIRE(histogram.percentile(100.0)  == Approx(100.0).epsilon(1e-3));
+
+  const auto serialized   = histogram.serialize();
+  const auto deserialized = bm::histogram<double>::deserialize(serialized);
+  REQUIRE(serialized.size()             <  10000 * sizeof(double));
+  REQUIRE(deserialized.count()          == histogram.count());
+  REQUIRE(deserialized.percentile(90.0) == histogram.percentile(90.0));
+
+  // Layouts whose unit is not positive or whose range overflows the bucket math are rejected.
+  REQUIRE_THROWS_AS(bm::histogram<double>(0.0 , 1e3), std::invalid_argument);
+  REQUIRE_THROWS_AS(bm::histogram<double>(-1.0, 1e3), std::invalid_argument);
+  REQUIRE_THROWS_AS(bm::histogram<double>(1e-9, 1e12), std::invalid_argument);
+
+  // A record switched to histogram storage without a layout uses the default one.
+  bm::record<double> switched {"switched"};
+  switched.storage = bm::storage::histogram;
+  for (auto i = 1; i <= 100; ++i)
+    switched.add(static_cast<double>(i));
+  REQUIRE(switched.histogram.count() == 100);
+  REQUIRE(switched.histogram.lowest() == 1e-3);
+  REQUIRE(switched.median()          == Approx(50.0).epsilon(1e-3));
+
+  bm::options options;
+  options.iterations = 1000;
+  options.storage    = bm::storage::histogram;
+  auto first  = bm::run<double, std::micro>([] { }, options);
+  auto second = bm::run<double, std::micro>([] { std::this_thread::sleep_for(std::chrono::microseconds(100)); }, 10);
+  REQUIRE(first.values.empty());
+  REQUIRE(first.histogram.count()  == options.iterations);
+  REQUIRE(first.percentile(50.0)   <= first.max());
+  REQUIRE(std::isfinite(first.mean()));
+
+  first.merge(second);
+  REQUIRE(first.histogram.count()  == options.iterations + 10);
+  REQUIRE(first.statistics.count() == options.iterations + 10);
+  REQUIRE(first.percentile(100.0)  == Approx(second.max()).epsilon(1e-3));
+  first.to_csv("output_histogram.csv");
+}
+
+TEST_CASE("bm::storage::reservoir")
+{
+  bm::options options;
+  options.iterations              = 10000;
+  options.storage                 = bm::storage::reservoir;
+  options.reservoir_size          = 100;
+  options.capture_thread_cpu_time = true;
+
+  std::size_t counter = 0;
+  auto record = bm::run<double, std::micro>([&counter] { bm_test_sink = ++counter; }, options);
+  REQUIRE(record.values           .size() == options.reservoir_size);
+  REQUIRE(record.thread_cpu_values.size() == options.reservoir_size);
+  REQUIRE(record.statistics       .count() == options.iterations);
+  REQUIRE(record.min() <= record.median());
+  REQUIRE(record.median() <= record.max());
+
+  bm::record<double> uniform {"uniform"};
+  uniform.storage        = bm::storage::reservoir;
+  uniform.reservoir_size = 1000;
+  for (auto i = 0; i < 100000; ++i)
+    uniform.add(static_cast<double>(i));
+  REQUIRE(uniform.mean  () == Approx(49999.5));
+  REQUIRE(uniform.min   () == 0.0);
+  REQUIRE(uniform.max   () == 99999.0);
+  REQUIRE(uniform.median() == Approx(50000.0).margin(5000.0));
+
+  bm::record<double> other {"other"};
+  for (auto i = 0; i < 10; ++i)
+    other.add(1e6);
+  uniform.merge(other);
+  REQUIRE(uniform.values    .size () == 1000);
+  REQUIRE(uniform.statistics.count() == 100010);
+  REQUIRE(uniform.max() == 1e6);
+}
+
+TEST_CASE("bm::do_not_optimize")
+{
+  std::vector<double> buffer(1000, 1.0);
+
+  const auto record = bm::run<double, std::nano>([&buffer]
+  {
+    return std::accumulate(buffer.begin(), buffer.end(), 0.0);
+  }, 100);
+  REQUIRE(record.values.size() == 100);
+  REQUIRE(record.mean()        >  0.0);
+
+  double value = 0.0;
+  for (auto i = 0; i < 100; ++i)
+  {
+    value += static_cast<double>(i);
+    bm::do_not_optimize(value);
+    buffer[0] = value;
+    bm::clobber_memory();
+  }
+  REQUIRE(buffer[0] == Approx(4950.0));
+
+  // Aggregates of sizes no register constraint accepts are passed through memory.
+  struct three { char a[3]; };
+  const auto aggregate = bm::run<double, std::nano>([ ] { return three {{1, 2, 3}}; }, 3);
+  REQUIRE(aggregate.values.size() == 3);
+  std::array<char, 3> bytes {{1, 2, 3}};
+  bm::do_not_optimize(bytes);
+  REQUIRE(bytes[2] == 3);
+}
+
+TEST_CASE("bm::options warmup and stopping criteria")
+{
+  std::size_t counter = 0;
+
+  bm::options options;
+  options.iterations = 10;
+  options.warmup     = 5;
+  auto record  = bm::run<double, std::micro>([&counter] { ++counter; }, options);
+  REQUIRE(counter              == 15);
+  REQUIRE(record.values.size() == 10);
+
+  auto session = bm::run<double, std::micro>([&counter] (auto& recorder) { recorder.record("increment", [&counter] { ++counter; }); }, options);
+  REQUIRE(counter                          == 30);
+  REQUIRE(session.records[0].values.size() == 10);
+
+  // Ignoring the budget would take at least 100 s, hence the upper bound (with generous slack for loaded machines) checks that the run stops.
+  options             = bm::options();
+  options.iterations  = 100000;
+  options.time_budget = std::chrono::milliseconds(20);
+  const auto start    = std::chrono::steady_clock::now();
+  record = bm::run<double, std::micro>([] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }, options);
+  const auto elapsed  = std::chrono::steady_clock::now() - start;
+  REQUIRE(record.values.size() >= 1);
+  REQUIRE(record.values.size() <  options.iterations);
+  REQUIRE(elapsed              >= options.time_budget);
+  REQUIRE(elapsed              <  options.time_budget + std::chrono::seconds(1));
+
+  options             = bm::options();
+  options.iterations  = 1000000;
+  options.target_relative_standard_error = 0.05;
+  std::vector<double> buffer(1000, 1.0);
+  record = bm::run<double, std::micro>([&buffer] { return std::accumulate(buffer.begin(), buffer.end(), 0.0); }, options);
+  REQUIRE(record.values.size()             <  options.iterations);
+  REQUIRE(record.relative_standard_error() <  0.05);
+
+  // Sections without samples have no precision to check and do not keep the session from stopping early.
+  options.sections = {"sum", "unused"};
+  session = bm::run<double, std::micro>([&buffer] (auto& recorder)
+  {
+    recorder.record(bm::handle {0}, [&buffer] { return std::accumulate(buffer.begin(), buffer.end(), 0.0); });
+  }, options);
+  REQUIRE(session.iterations                           <  options.iterations);
+  REQUIRE(session.records[0].relative_standard_error() <  0.05);
+  REQUIRE(session.records[1].values.empty());
+}
+
+TEST_CASE("bm::options target confidence interval")
+{
+  REQUIRE(bm::normal_quantile   (0.975)              == Approx(1.959964).epsilon(1e-6));
+  REQUIRE(bm::student_t_quantile(0.975, 10.0)        == Approx(2.228139).epsilon(1e-6));
+  REQUIRE(bm::student_t_quantile(0.995, 2.0 )        == Approx(9.924843).epsilon(1e-6));
+  REQUIRE(bm::student_t_quantile(0.975, 1000.0)      == Approx(1.962339).epsilon(1e-6));
+  REQUIRE(bm::student_t_cdf     (2.228139, 10.0)     == Approx(0.975   ).epsilon(1e-6));
+
+  bm::record<double> record {"interval", {1.0, 2.0, 3.0, 4.0, 5.0}};
+  const auto interval = record.confidence_interval(0.95);
+  REQUIRE(interval.lower == Approx(3.0 - 2.776445 * std::sqrt(2.5 / 5.0)));
+  REQUIRE(interval.upper == Approx(3.0 + 2.776445 * std::sqrt(2.5 / 5.0)));
+
+  std::vector<double> buffer(1000, 1.0);
+  bm::options options;
+  options.iterations                 = 1000000;
+  options.min_iterations             = 20;
+  options.target_confidence_interval = 0.05;
+  const auto converged = bm::run<double, std::micro>([&buffer] { return std::accumulate(buffer.begin(), buffer.end(), 0.0); }, options);
+  REQUIRE(converged.iterations    >= options.min_iterations);
+  REQUIRE(converged.iterations    <  options.iterations);
+  REQUIRE(converged.values.size() == converged.iterations);
+  REQUIRE(converged.confidence_interval(0.95).width() / converged.mean() < 0.05);
+
+  const auto session = bm::run<double, std::micro>([&buffer] (auto& recorder)
+  {
+    recorder.record("accumulate", [&buffer] { return std::accumulate(buffer.begin(), buffer.end(), 0.0); });
+  }, options);
+  REQUIRE(session.iterations            <  options.iterations);
+  REQUIRE(session.records[0].iterations == session.iterations);
+}
+
+TEST_CASE("bm::bootstrap")
+{
+  bm::record<double> record {"bootstrap"};
+  for (auto i = 1; i <= 100; ++i)
+    record.add(static_cast<double>(i));
+
+  const auto mean   = record.bootstrap_interval(bm::estimator::mean  );
+  const auto median = record.bootstrap_interval(bm::estimator::median);
+  REQUIRE(mean  .lower < 50.5);
+  REQUIRE(mean  .upper > 50.5);
+  REQUIRE(mean  .width() > 8.0 );
+  REQUIRE(mean  .width() < 16.0);
+  REQUIRE(median.lower < 50.5);
+  REQUIRE(median.upper > 50.5);
+
+  const auto percentile = record.bootstrap_interval(bm::estimator::mean, 0.95, bm::bootstrap_method::percentile);
+  REQUIRE(percentile.lower == Approx(mean.lower).epsilon(0.05));
+  REQUIRE(percentile.upper == Approx(mean.upper).epsilon(0.05));
+  REQUIRE(record.bootstrap_interval(bm::estimator::mean, 0.5).width() < mean.width());
+
+  // Large inputs are distributed over threads without changing the result.
+  std::vector<double> values(4096);
+  for (std::size_t i = 0; i < values.size(); ++i)
+    values[i] = static_cast<double>(i % 97);
+  const auto first  = bm::bootstrap(values, bm::estimator::median, 0.95, 512);
+  const auto second = bm::bootstrap(values, bm::estimator::median, 0.95, 512);
+  REQUIRE(first.lower == second.lower);
+  REQUIRE(first.upper == second.upper);
+
+  REQUIRE(std::isnan(bm::bootstrap(std::vector<double>{1.0}, bm::estimator::mean).lower));
+  REQUIRE(record.header().find("mean lower bound,mean upper bound,median lower bound,median upper bound") != std::string::npos);
+
+  // The csv columns are empty unless resamples are requested.
+  const auto cell = [&record] (const std::string& column)
+  {
+    const auto header = record.header(), row = record.to_string();
+    const auto index  = std::count(header.begin(), header.begin() + static_cast<std::ptrdiff_t>(header.find(column)), ',');
+    std::size_t begin = 0;
+    for (auto i = 0; i < index; ++i)
+      begin = row.find(',', begin) + 1;
+    return row.substr(begin, row.find(',', begin) - begin);
+  };
+  REQUIRE(cell("mean lower bound").empty());
+  REQUIRE(record.header().find("trimmed mean") == std::string::npos);
+  record.bootstrap_resamples = 200;
+  REQUIRE(std::stod(cell("mean lower bound")) < 50.5);
+}
+
+TEST_CASE("bm::record outliers")
+{
+  bm::record<double> record {"outliers"};
+  for (auto i = 0; i < 100; ++i)
+    record.add(10.0 + static_cast<double>(i % 10) * 0.1);
+  record.add(12.0 );
+  record.add(100.0);
+  record.add(1.0  );
+
+  const auto tukey = record.outliers();
+  REQUIRE(tukey.low_severe  == 1);
+  REQUIRE(tukey.high_mild   == 1);
+  REQUIRE(tukey.high_severe == 1);
+  REQUIRE(tukey.total()     == 3);
+  const auto mad = record.outliers(bm::outlier_method::mad);
+  REQUIRE(mad.mild  () == 1);
+  REQUIRE(mad.severe() == 2);
+
+  REQUIRE(record.trimmed_mean  () == Approx(10.45).epsilon(0.01));
+  REQUIRE(record.hodges_lehmann() == Approx(10.45).epsilon(0.01));
+  REQUIRE(record.mean() > 11.0);
+  REQUIRE(record.max () == 100.0);
+
+  record.exclude_outliers = bm::outlier_method::tukey;
+  REQUIRE(record.mean() == Approx(10.45));
+  REQUIRE(record.max () == Approx(10.9 ));
+  REQUIRE(record.standard_deviation() < 0.3);
+
+  record.add(50.0);
+  REQUIRE(record.max () == Approx(10.9 ));
+  REQUIRE(record.statistics.max() == 100.0);
+
+  bm::record<double> pairs {"pairs", {1.0, 2.0, 9.0}};
+  REQUIRE(pairs.hodges_lehmann() == Approx(3.5));
+
+  // With outliers excluded, the convergence checks are spaced so that their total cost stays linear.
+  bm::options options;
+  options.target_relative_standard_error = 0.01;
+  options.exclude_outliers               = bm::outlier_method::tukey;
+  std::size_t checks = 0;
+  for (std::size_t i = 0; i < 100000; ++i)
+    bm::stop_early(options, std::chrono::steady_clock::now(), i, [&checks] { ++checks; return false; });
+  REQUIRE(checks > 0  );
+  REQUIRE(checks < 300);
+}
+
+TEST_CASE("bm::compare")
+{
+  bm::record<double> baseline {"baseline"}, contender {"contender"}, same {"same"};
+  for (auto i = 0; i < 50; ++i)
+  {
+    const auto noise = static_cast<double>((i * 37) % 11) * 0.1;
+    baseline .add(10.0 + noise);
+    contender.add(5.0  + noise);
+    same     .add(10.0 + static_cast<double>((i * 17) % 11) * 0.1);
+  }
+
+  const auto faster = bm::compare(baseline, contender);
+  REQUIRE(faster.speedup                 == Approx(10.5 / 5.5).epsilon(0.01));
+  REQUIRE(faster.speedup_interval.lower  <  faster.speedup);
+  REQUIRE(faster.speedup_interval.upper  >  faster.speedup);
+  REQUIRE(faster.welch_p                 <  1e-6);
+  REQUIRE(faster.mann_whitney_u          == Approx(2500.0));
+  REQUIRE(faster.mann_whitney_p          <  1e-6);
+  REQUIRE(faster.faster());
+  REQUIRE(bm::compare(contender, baseline).slower());
+
+  const auto unchanged = bm::compare(baseline, same);
+  REQUIRE(unchanged.speedup_interval.lower < 1.0);
+  REQUIRE(unchanged.speedup_interval.upper > 1.0);
+  REQUIRE(unchanged.welch_p        > 0.05);
+  REQUIRE(unchanged.mann_whitney_p > 0.05);
+  REQUIRE(!unchanged.significant());
+
+  REQUIRE(std::isnan(bm::compare(bm::record<double>(), contender).speedup));
+}
+
+TEST_CASE("bm::detect_regressions")
+{
+  bm::session<double> baseline;
+  baseline.insert(bm::record<double>("stable"));
+  baseline.insert(bm::record<double>("slowed"));
+  baseline.insert(bm::record<double>("removed"));
+  for (auto i = 0; i < 40; ++i)
+  {
+    const auto noise = static_cast<double>((i * 37) % 11) * 0.1;
+    bm::sample<double> sample;
+    sample.wall       = 10.0 + noise;
+    sample.thread_cpu = 1.0  + noise;
+    baseline.records[0].add(sample);
+    baseline.records[1].add(10.0 + noise);
+    if (i < 20)
+      baseline.records[2].add(10.0 + noise);
+  }
+  baseline.to_csv("output_baseline.csv");
+
+  const auto loaded = bm::session<double>::from_csv("output_baseline.csv");
+  REQUIRE(loaded.records.size()                          == 3);
+  REQUIRE(loaded.records[0].values                       == baseline.records[0].values);
+  REQUIRE(loaded.records[0].thread_cpu_values            == baseline.records[0].thread_cpu_values);
+  REQUIRE(loaded.records[2].values.size()                == 20);
+  REQUIRE(loaded.records[1].process_cpu_values.empty());
+  REQUIRE(loaded.records[1].mean()                       == Approx(baseline.records[1].mean()));
+  REQUIRE(loaded.find("removed")                         == 2);
+
+  bm::session<double> current;
+  current.insert(bm::record<double>("stable"));
+  current.insert(bm::record<double>("slowed"));
+  current.insert(bm::record<double>("added" ));
+  for (auto i = 0; i < 40; ++i)
+  {
+    const auto noise = static_cast<double>((i * 17) % 11) * 0.1;
+    current.records[0].add(10.0 + noise);
+    current.records[1].add(12.0 + noise);
+    current.records[2].add(1.0  + noise);
+  }
+
+  const auto report = bm::detect_regressions(loaded, current);
+  REQUIRE(report.entries.size()     == 4);
+  REQUIRE(report.entries[0].verdict == bm::verdict::unchanged);
+  REQUIRE(report.entries[1].verdict == bm::verdict::regressed);
+  REQUIRE(report.entries[2].verdict == bm::verdict::added    );
+  REQUIRE(report.entries[3].verdict == bm::verdict::missing  );
+  REQUIRE(!report.passed());
+  REQUIRE(report.to_string().find("slowed,regressed") != std::string::npos);
+
+  bm::regression_criteria lenient;
+  lenient.tolerance = 0.25;
+  REQUIRE(bm::detect_regressions(loaded, current, lenient).passed());
+  lenient.fail_on_missing = true;
+  REQUIRE(!bm::detect_regressions(loaded, current, lenient).passed());
+
+  // Records of different units, or without samples to compare (a histogram read back from csv), are incomparable.
+  bm::options options;
+  options.iterations = 20;
+  options.storage    = bm::storage::histogram;
+  auto micro = bm::run<double, std::micro>([ ] (auto& recorder) { recorder.record("sleep", [ ] { std::this_thread::sleep_for(std::chrono::microseconds(50)); }); }, 20);
+  auto nano  = bm::run<double, std::nano >([ ] (auto& recorder) { recorder.record("sleep", [ ] { std::this_thread::sleep_for(std::chrono::microseconds(50)); }); }, 20);
+  micro.to_csv("output_micro.csv");
+  const auto stored = bm::session<double>::from_csv("output_micro.csv");
+  REQUIRE(stored.records[0].unit == "us");
+  REQUIRE(bm::detect_regressions(stored, micro).entries[0].verdict == bm::verdict::unchanged   );
+  REQUIRE(bm::detect_regressions(stored, nano ).entries[0].verdict == bm::verdict::incomparable);
+  REQUIRE(!bm::detect_regressions(stored, nano).passed());
+
+  bm::run<double, std::micro>([ ] (auto& recorder) { recorder.record("sleep", [ ] { }); }, options).to_csv("output_histogram_baseline.csv");
+  const auto histogram = bm::session<double>::from_csv("output_histogram_baseline.csv");
+  REQUIRE(histogram.records[0].values.empty());
+  const auto report_histogram = bm::detect_regressions(histogram, micro);
+  REQUIRE(report_histogram.entries[0].verdict == bm::verdict::incomparable);
+  REQUIRE(report_histogram.to_string().find("sleep,incomparable") == 0);
+}
+
+TEST_CASE("bm::record from_csv")
+{
+  bm::record<double> record {"round trip"};
+  for (auto i = 0; i < 16; ++i)
+  {
+    bm::sample<double> sample;
+    sample.wall        = 1.0 / static_cast<double>(i + 3);
+    sample.process_cpu = static_cast<double>(i);
+    record.add(sample);
+  }
+  record.to_csv("output_round_trip.csv");
+
+  const auto loaded = bm::record<double>::from_csv("output_round_trip.csv");
+  REQUIRE(loaded.name               == record.name);
+  REQUIRE(loaded.values             == record.values);
+  REQUIRE(loaded.process_cpu_values == record.process_cpu_values);
+  REQUIRE(loaded.thread_cpu_values.empty());
+  REQUIRE(loaded.statistics.count() == 16);
+  REQUIRE(loaded.iterations         == 16);
+
+  // Rank column, carriage returns, padded cells and blank lines.
+  {
+    std::ofstream stream("output_ranks.csv", std::ios::binary);
+    stream << "rank,name,run_0,run_1,run_2,mean\r\n";
+    stream << "0,first,1.5,2.5,,2\r\n";
+    stream << "\r\n";
+    stream << "1,second,3,4,5,4\r\n";
+  }
+  const auto session = bm::session<double>::from_csv("output_ranks.csv");
+  REQUIRE(session.records.size()     == 2);
+  REQUIRE((session.records[0].values == std::vector<double>{1.5, 2.5}));
+  REQUIRE(session.records[1].name    == "second");
+  REQUIRE(session.records[1].mean()  == Approx(4.0));
+  REQUIRE(session.iterations         == 3);
+  REQUIRE(bm::session<double>::from_csv("output_missing.csv").records.empty());
+
+  // Names with separators, quotes and line breaks are quoted (RFC 4180).
+  bm::session<double> quoted;
+  quoted.records = {{"copy, 4 KiB", {1.0, 2.0, 3.0, 4.0, 5.0}}, {"say \"hi\"\ntwice", {6.0}}};
+  quoted.records[0].unit = "us";
+  quoted.to_csv("output_quoted.csv");
+  const auto unquoted = bm::session<double>::from_csv("output_quoted.csv");
+  REQUIRE(unquoted.records.size()        == 2);
+  REQUIRE(unquoted.records[0].name       == "copy, 4 KiB");
+  REQUIRE(unquoted.records[0].unit       == "us");
+  REQUIRE(unquoted.records[0].values     == quoted.records[0].values);
+  REQUIRE(unquoted.records[0].mean()     == Approx(3.0));
+  REQUIRE(unquoted.records[1].name       == "say \"hi\"\ntwice");
+  REQUIRE(unquoted.records[1].values     == quoted.records[1].values);
+
+  quoted.to_hierarchical_csv("output_quoted_hierarchical.csv");
+  std::ifstream stream("output_quoted_hierarchical.csv");
+  std::string   line;
+  std::getline(stream, line);
+  std::getline(stream, line);
+  REQUIRE(line.find("\"copy, 4 KiB\",\"copy, 4 KiB\",0,5,") == 0);
+}
+
+TEST_CASE("bm::mapped_session")
+{
+  auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    recorder.record("first" , [ ] { bm_test_sink = bm_test_sink + 1; });
+    recorder.record("second", [ ] { bm_test_sink = bm_test_sink + 2; });
+  }, 100);
+  session.records[1].thread_cpu_values.assign(session.records[1].values.size(), 0.5);
+
+  for (auto compression : {bm::binary_compression::none, bm::binary_compression::xor_delta})
+  {
+    session.to_binary("output_session.bin", compression);
+
+    const bm::mapped_session<double> mapped("output_session.bin");
+    REQUIRE(mapped.valid());
+    REQUIRE(mapped.records().size()   == 2);
+    REQUIRE(mapped.iterations()       == session.iterations);
+    REQUIRE(mapped.clock_overhead()   == session.clock_overhead);
+
+    const auto& view = mapped.records()[1];
+    REQUIRE(view.name                 == "second");
+    REQUIRE(view.unit                 == "us");
+    REQUIRE(view.clock                == "high_resolution_clock");
+    REQUIRE(view.values.size          == session.records[1].values.size());
+    REQUIRE(std::equal(view.values.begin(), view.values.end(), session.records[1].values.begin()));
+    REQUIRE(view.thread_cpu_values[7] == 0.5);
+    REQUIRE(view.process_cpu_values.empty());
+    if (compression == bm::binary_compression::none)
+      REQUIRE(reinterpret_cast<std::uintptr_t>(view.values.data) % 64 == 0);
+
+    const auto loaded = mapped.to_session();
+    REQUIRE(loaded.records[0].values == session.records[0].values);
+    REQUIRE(loaded.records[0].mean()  == Approx(session.records[0].mean()));
+  }
+
+  REQUIRE(!bm::mapped_session<float >("output_session.bin").valid());
+  REQUIRE(!bm::mapped_session<double>("output_missing.bin").valid());
+
+  // Other format versions and unknown compressions are rejected.
+  for (auto field : {offsetof(bm::binary_header, version), offsetof(bm::binary_header, compression)})
+  {
+    session.to_binary("output_session.bin");
+    REQUIRE(bm::mapped_session<double>("output_session.bin").valid());
+    {
+      std::fstream stream("output_session.bin", std::ios::binary | std::ios::in | std::ios::out);
+      const std::uint32_t value = 7;
+      stream.seekp(field);
+      stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    REQUIRE(!bm::mapped_session<double>("output_session.bin").valid());
+  }
+
+  // Histograms keep their running statistics.
+  bm::options options;
+  options.iterations = 50;
+  options.storage    = bm::storage::histogram;
+  const auto histogram = bm::run<double, std::micro>([ ] (auto& recorder) { recorder.record("histogram", [ ] { bm_test_sink = bm_test_sink + 1; }); }, options);
+  histogram.to_binary("output_histogram.bin");
+  const bm::mapped_session<double> mapped("output_histogram.bin");
+  REQUIRE(mapped.valid());
+  REQUIRE(mapped.records()[0].statistics.count() == 50);
+  const auto restored = mapped.to_session().records[0];
+  REQUIRE(restored.values.empty());
+  REQUIRE(restored.mean    () == Approx(histogram.records[0].mean    ()));
+  REQUIRE(restored.variance() == Approx(histogram.records[0].variance()));
+  REQUIRE(restored.max     () == histogram.records[0].max());
+
+  // Unknown storages, histograms of an invalid layout (e.g. a zero lowest value, which is divided by) and value columns misaligned for
+  // their type are rejected.
+  std::ifstream      file("output_histogram.bin", std::ios::binary);
+  std::ostringstream bytes;
+  bytes << file.rdbuf();
+  bm::binary_header  header;
+  std::memcpy(&header, bytes.str().data(), sizeof(header));
+  const auto& record  = histogram.records[0];
+  const auto  storage = static_cast<std::size_t>(header.directory_offset) + 3 * sizeof(std::uint32_t) + record.name.size() + record.unit.size() + record.clock.size();
+  const auto  columns = storage + 4 * sizeof(std::uint64_t) + 2 * sizeof(double);
+  bm::binary_column column;
+  std::memcpy(&column, bytes.str().data() + columns + 3 * sizeof(bm::binary_column), sizeof(column));
+  for (auto [offset, value] : {std::make_pair(storage, std::uint64_t(7)), std::make_pair(static_cast<std::size_t>(column.offset), std::uint64_t(0)), std::make_pair(columns, std::uint64_t(65))})
+  {
+    histogram.to_binary("output_histogram.bin");
+    {
+      std::fstream stream("output_histogram.bin", std::ios::binary | std::ios::in | std::ios::out);
+      stream.seekp(static_cast<std::streamoff>(offset));
+      stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    REQUIRE(!bm::mapped_session<double>("output_histogram.bin").valid());
+  }
+}
+
+TEST_CASE("bm::session to_json")
+{
+  bm::options options;
+  options.iterations = 10;
+  options.capture_thread_cpu_time = true;
+  auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    recorder.record("first" , [ ] { bm_test_sink = bm_test_sink + 1; });
+    recorder.record("second", [ ] { bm_test_sink = bm_test_sink + 2; });
+  }, options);
+  session.records[1].name = "quoted \"second\"";
+
+  const auto read = [ ] (const std::string& filepath)
+  {
+    std::ifstream      stream(filepath);
+    std::ostringstream buffer;
+    buffer << stream.rdbuf();
+    return buffer.str();
+  };
+  const auto occurrences = [ ] (const std::string& text, const std::string& pattern)
+  {
+    std::size_t count = 0;
+    for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+      ++count;
+    return count;
+  };
+
+  session.to_json("output_session.json");
+  const auto json = read("output_session.json");
+  REQUIRE(json.find("\"context\": {")                          != std::string::npos);
+  REQUIRE(json.find("\"num_cpus\": ")                          != std::string::npos);
+  REQUIRE(json.find("\"name\": \"first_mean\"")                != std::string::npos);
+  REQUIRE(json.find("\"name\": \"quoted \\\"second\\\"_cv\"")  != std::string::npos);
+  REQUIRE(json.find("\"time_unit\": \"us\"")                   != std::string::npos);
+  REQUIRE(occurrences(json, "\"run_type\": \"iteration\"")     == 20);
+  REQUIRE(occurrences(json, "\"run_type\": \"aggregate\"")     == 8 );
+  REQUIRE(occurrences(json, "{") == occurrences(json, "}"));
+
+  session.to_json("output_session_aggregates.json", true);
+  const auto aggregates = read("output_session_aggregates.json");
+  REQUIRE(occurrences(aggregates, "\"run_type\": \"iteration\"") == 0);
+  REQUIRE(occurrences(aggregates, "\"aggregate_name\": \"median\"") == 2);
+}
+
+TEST_CASE("bm::options timeline")
+{
+  bm::options options;
+  options.iterations = 5;
+  options.timeline = true;
+  options.warmup   = 2;
+  const auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    recorder.record("outer", [&recorder]
+    {
+      recorder.record("inner", [ ] { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+    });
+  }, options);
+
+  REQUIRE(session.timeline.size() == 10);
+  for (std::size_t i = 0; i < session.timeline.size(); i += 2)
+  {
+    const auto& inner = session.timeline[i], & outer = session.timeline[i + 1];
+    REQUIRE(session.records[inner.record].name == "outer/inner");
+    REQUIRE(session.records[outer.record].name == "outer");
+    REQUIRE(inner.iteration == i / 2);
+    REQUIRE(inner.start >= outer.start);
+    REQUIRE(inner.end   <= outer.end  );
+    REQUIRE(outer.end - outer.start == Approx(session.records[outer.record].values[i / 2]));
+    if (i > 0)
+      REQUIRE(outer.start >= session.timeline[i - 1].end);
+  }
+
+  session.to_trace("output_trace.json");
+  std::ifstream      stream("output_trace.json");
+  std::ostringstream buffer;
+  buffer << stream.rdbuf();
+  REQUIRE(buffer.str().find("{\"traceEvents\":[\n{\"name\":\"inner\",\"cat\":\"bm\",\"ph\":\"X\",") == 0);
+
+  REQUIRE(bm::run([ ] (bm::session_recorder<>& recorder) { recorder.record("section", [ ] { }); }, 3).timeline.empty());
+
+  // Runs bounded by a budget reserve a bounded timeline rather than one for every possible iteration.
+  options             = bm::options();
+  options.iterations  = std::numeric_limits<std::size_t>::max();
+  options.time_budget = std::chrono::milliseconds(5);
+  options.timeline    = true;
+  const auto budgeted = bm::run([ ] (bm::session_recorder<>& recorder) { recorder.record("section", [ ] { }); }, options);
+  REQUIRE(budgeted.iterations      <  options.iterations);
+  REQUIRE(budgeted.timeline.size() == budgeted.iterations);
+}
+
+TEST_CASE("bm::session_recorder move")
+{
+  static_assert(std::is_nothrow_move_constructible_v<bm::session_recorder<double, std::nano>>);
+
+  // The moved to recorder keeps the samples buffered by the moved from one, and merges them once.
+  bm::session<double> session;
+  {
+    bm::session_recorder<double, std::nano> recorder(0, 2, session);
+    recorder.record("moved", [ ] { });
+    bm::session_recorder<double, std::nano> moved(std::move(recorder));
+    moved.record("moved", [ ] { });
+  }
+  REQUIRE(session.records.size()           == 1);
+  REQUIRE(session.records[0].values.size() == 2);
+}
+
+TEST_CASE("bm::session_recorder nested sections")
+{
+  const auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    recorder.record("outer", [&recorder]
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      recorder.record("inner;1", [ ] { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+      recorder.record("inner;1", [ ] { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+    });
+    recorder.record("flat", [ ] { });
+  }, 5);
+
+  REQUIRE(session.records.size() == 3);
+  const auto& outer = session.records[session.find("outer")];
+  const auto& inner = session.records[session.find("outer/inner;1")];
+  REQUIRE(!outer.parent);
+  REQUIRE(inner.parent == std::optional<std::size_t>(0));
+  REQUIRE(inner.values.size() == 10);
+  REQUIRE(outer.exclusive_statistics.count() == 5);
+  REQUIRE(outer.exclusive_statistics.mean() <  outer.statistics.mean());
+  REQUIRE(outer.exclusive_statistics.mean() >= 200.0);
+
+  session.to_hierarchical_csv("output_hierarchical.csv");
+  std::ifstream            stream("output_hierarchical.csv");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(stream, line);)
+    lines.push_back(line);
+  REQUIRE(lines.size() == 4);
+  REQUIRE(lines[0] == "path,name,depth,calls,inclusive mean,inclusive total,exclusive mean,exclusive total");
+  REQUIRE(lines[1].find("outer,outer,0,5,")           == 0);
+  REQUIRE(lines[2].find("outer/inner;1,inner;1,1,10,") == 0);
+  REQUIRE(lines[3].find("flat,flat,0,5,")             == 0);
+
+  session.to_folded("output_folded.txt");
+  std::ifstream folded("output_folded.txt");
+  std::string   line;
+  REQUIRE(std::getline(folded, line));
+  REQUIRE(line.find("outer ")         == 0);
+  REQUIRE(std::getline(folded, line));
+  REQUIRE(line.find("outer;inner_1 ") == 0);
+  REQUIRE(std::stoll(line.substr(14)) >= 1000000);
+
+  // Sections declared by path are nested in the section of their prefix, whichever is declared first.
+  bm::options options;
+  options.iterations = 5;
+  options.sections   = {"outer/inner", "outer", "outer/inner/leaf"};
+  const auto declared = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    recorder.record(bm::handle {1}, [&recorder] { recorder.record(bm::handle {0}, [ ] { }); });
+  }, options);
+  REQUIRE(declared.records.size()    == 3);
+  REQUIRE(declared.records[0].parent == std::optional<std::size_t>(1));
+  REQUIRE(declared.records[2].parent == std::optional<std::size_t>(0));
+  REQUIRE(!declared.records[1].parent);
+  REQUIRE(declared.records[1].exclusive_statistics.count() == 5);
+
+  // The overhead is subtracted from the nested sections before their times are subtracted from the enclosing one, hence the exclusive
+  // time of a section with several nested ones is its recorded time less theirs.
+  constexpr std::size_t children = 8;
+  options            = bm::options();
+  options.iterations        = 20;
+  options.subtract_overhead = true;
+  const auto subtracted = bm::run<double, std::nano>([ ] (bm::session_recorder<double, std::nano>& recorder)
+  {
+    recorder.record("parent", [&recorder]
+    {
+      for (std::size_t i = 0; i < children; ++i)
+        recorder.record("child", [ ] { bm_test_sink = bm_test_sink + 1; });
+    });
+  }, options);
+  const auto& parent = subtracted.records[subtracted.find("parent"      )];
+  const auto& child  = subtracted.records[subtracted.find("parent/child")];
+  REQUIRE(parent.values.size() == options.iterations           );
+  REQUIRE(child .values.size() == options.iterations * children);
+  double exclusive = 0.0;
+  for (std::size_t i = 0; i < options.iterations; ++i)
+  {
+    double nested = 0.0;
+    for (std::size_t j = 0; j < children; ++j)
+      nested += child.values[i * children + j];
+    exclusive += std::max(parent.values[i] - nested, 0.0);
+  }
+  REQUIRE(parent.exclusive_statistics.mean() == Approx(exclusive / static_cast<double>(options.iterations)));
+}
+
+TEST_CASE("bm::scoped_section")
+{
+  const auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    const auto outer = recorder.scope("outer");
+    {
+      bm::scoped_section<double, std::micro> inner(recorder, "inner");
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    const auto handle = recorder.handle("manual");
+    recorder.start(handle);
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    recorder.stop (recorder.handle("unstarted"));
+    recorder.stop (handle);
+  }, 5);
+
+  REQUIRE(session.records.size() == 4);
+  REQUIRE(session.find("outer/manual/unstarted") <  session.records.size());
+  const auto& outer  = session.records[session.find("outer"                 )];
+  const auto& inner  = session.records[session.find("outer/inner"           )];
+  const auto& manual = session.records[session.find("outer/manual"          )];
+  const auto& none   = session.records[session.find("outer/manual/unstarted")];
+  REQUIRE(outer .values.size() == 5);
+  REQUIRE(inner .values.size() == 5);
+  REQUIRE(manual.values.size() == 5);
+  REQUIRE(none  .values.empty());
+  REQUIRE(inner .min() >= 100.0);
+  REQUIRE(manual.min() >= 100.0);
+  REQUIRE(outer .min() >= inner.min() + manual.min());
+}
+
+TEST_CASE("bm::session_recorder concurrent recording")
+{
+  bm::options options;
+  options.iterations = 3;
+  options.timeline = true;
+  const auto session = bm::run<double, std::micro>([ ] (bm::session_recorder<double, std::micro>& recorder)
+  {
+    const auto task = recorder.handle("task");
+    recorder.record("pipeline", [&recorder, task]
+    {
+      // The workers wait for each other before exiting, hence all four hold a thread index at once.
+      std::mutex               mutex;
+      std::condition_variable  condition;
+      std::size_t              arrived = 0;
+      std::vector<std::thread> workers;
+      for (std::size_t i = 0; i < 4; ++i)
+        workers.emplace_back([&recorder, &mutex, &condition, &arrived, task]
+        {
+          for (std::size_t j = 0; j < 10; ++j)
+          {
+            recorder.record(task, [ ] { std::this_thread::sleep_for(std::chrono::microseconds(10)); });
+            const auto section = recorder.scope("worker");
+            recorder.record("step", [ ] { });
+          }
+          std::unique_lock<std::mutex> lock(mutex);
+          if (++arrived == 4)
+            condition.notify_all();
+          condition.wait(lock, [&arrived] { return arrived == 4; });
+        });
+      for (auto& worker : workers)
+        worker.join();
+    });
+  }, options);
+
+  REQUIRE(session.records.size() == 4);
+  REQUIRE(session.records[session.find("pipeline"   )].values.size() == 3  );
+  REQUIRE(session.records[session.find("task"       )].values.size() == 120);
+  REQUIRE(session.records[session.find("worker"     )].values.size() == 120);
+  REQUIRE(session.records[session.find("worker/step")].values.size() == 120);
+  REQUIRE(session.records[session.find("task"       )].min() >= 10.0);
+
+  std::set<std::uint32_t>              threads;
+  std::vector<std::set<std::uint32_t>> iteration_threads(options.iterations);
+  for (auto& event : session.timeline)
+    if (event.record == session.find("task"))
+    {
+      threads.insert(event.thread);
+      iteration_threads[event.iteration].insert(event.thread);
+    }
+  REQUIRE(session.timeline.size() == 363);
+  for (auto& iteration : iteration_threads)
+    REQUIRE(iteration.size() == 4);
+  // The indices of the workers of an iteration are released on exit and reused (smallest first) by those of the next, hence so are
+  // their buffers.
+  REQUIRE(threads.size() == 4);
+
+  // Each sample is tagged with its thread, hence the samples of each thread can be told apart.
+  const auto& task = session.records[session.find("task")];
+  REQUIRE(task.threads.size() == task.values.size());
+  REQUIRE(std::set<std::uint32_t>(task.threads.begin(), task.threads.end()) == threads);
+  for (auto thread : threads)
+    REQUIRE(std::count(task.threads.begin(), task.threads.end(), thread) == 30);
+  REQUIRE(session.records[session.find("pipeline")].threads == std::vector<std::uint32_t>(3, bm::thread_index()));
+  auto merged = task;
+  merged.merge(task);
+  REQUIRE(merged.threads.size() == merged.values.size());
+
+  // The tags are kept by the exports.
+  session.to_csv   ("output_threads.csv");
+  session.to_binary("output_threads.bin");
+  session.to_json  ("output_threads.json");
+  const auto read   = bm::session<double>::from_csv("output_threads.csv");
+  REQUIRE(read.records[read.find("task")].threads == task.threads);
+  const bm::mapped_session<double> mapped("output_threads.bin");
+  REQUIRE(mapped.valid());
+  REQUIRE(mapped.to_session().records[session.find("task")].threads == task.threads);
+  std::ifstream      json("output_threads.json");
+  std::ostringstream text;
+  text << json.rdbuf();
+  REQUIRE(text.str().find("\"thread_index\": " + std::to_string(task.threads[0])) != std::string::npos);
+}